@@ -0,0 +1,369 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-3-Clause) */
+/*
+ * AD7293 platform neutral core
+ *
+ * Shared as is by the Linux and no-OS drivers: register encoding, SPI frame
+ * layout, page select planning and the channel descriptor table. Nothing is
+ * included here, the driver provides uint8_t and uint16_t (linux/types.h or
+ * stdint.h) before including this file.
+ *
+ * Copyright 2021 Analog Devices Inc.
+ */
+
+#ifndef __AD7293_CORE_H__
+#define __AD7293_CORE_H__
+
+/*
+ * Registers are encoded as their transfer length in bytes (bits 17:16), page
+ * (bits 15:8) and address within the page (bits 7:0).
+ */
+#define AD7293_R1B				(1U << 16)
+#define AD7293_R2B				(2U << 16)
+#define AD7293_TRANSF_LEN_MSK			(3U << 16)
+#define AD7293_PAGE_ADDR_MSK			(0xFFU << 8)
+#define AD7293_PAGE(x)				((unsigned int)(x) << 8)
+#define AD7293_REG_ADDR_MSK			0xFFU
+
+/* Command byte: read flag and address */
+#define AD7293_READ				0x80U
+/* Longest frame: command byte and a 16-bit register */
+#define AD7293_FRAME_MAX_BYTES			3
+/* Page select register, common to all pages */
+#define AD7293_PAGE_SELECT_ADDR			0x01
+/* Registers 0x00 to 0x0F are reachable whatever the selected page */
+#define AD7293_NUM_COMMON_REGS			0x10
+/* Cached page value forcing the next access to reselect the page */
+#define AD7293_PAGE_INVALID			0xFF
+
+/*
+ * Pages of the channel registers, relative to the result page. The limit,
+ * hysteresis and min/max registers of a channel sit at its address on their
+ * own pages, two pages apart for each kind.
+ */
+#define AD7293_SEQ_PAGE				0x3
+#define AD7293_LIMIT_PAGES			0x4
+#define AD7293_OFFSET_PAGES			0xE
+
+#define AD7293_NUM_VINX				4
+#define AD7293_NUM_ISENSE			4
+#define AD7293_NUM_TSENSE			3
+#define AD7293_NUM_SUPPLY			4
+#define AD7293_NUM_BI_VOUT_MON			4
+#define AD7293_NUM_RS_MON			4
+#define AD7293_NUM_DAC				8
+
+/* Channel types, as the drivers address channels */
+enum ad7293_ch_type {
+	AD7293_ADC_VINX,
+	AD7293_ADC_TSENSE,
+	AD7293_ADC_ISENSE,
+	AD7293_DAC,
+	/* AVDD, DACVDD_UNI, DACVDD_BI and AVSS monitors, in that order */
+	AD7293_ADC_SUPPLY,
+	/* Bipolar DAC output monitors */
+	AD7293_ADC_BI_VOUT_MON,
+	/* Sense resistor monitors */
+	AD7293_ADC_RS_MON,
+};
+
+/* Window registers of an ADC channel, in page order */
+enum ad7293_limit {
+	AD7293_LIMIT_HIGH,
+	AD7293_LIMIT_LOW,
+	AD7293_LIMIT_HYST,
+	AD7293_LIMIT_MIN,
+	AD7293_LIMIT_MAX,
+	AD7293_NUM_LIMITS,
+};
+static inline unsigned int ad7293_reg(unsigned int len, uint8_t page,
+				      uint8_t addr)
+{
+	return len | AD7293_PAGE(page) | addr;
+}
+
+static inline uint8_t ad7293_reg_page(unsigned int reg)
+{
+	return (reg & AD7293_PAGE_ADDR_MSK) >> 8;
+}
+
+static inline uint8_t ad7293_reg_addr(unsigned int reg)
+{
+	return reg & AD7293_REG_ADDR_MSK;
+}
+
+/* Register width in bytes */
+static inline unsigned int ad7293_reg_len(unsigned int reg)
+{
+	return (reg & AD7293_TRANSF_LEN_MSK) >> 16;
+}
+
+/*
+ * Fill @buf with the page select frame needed to reach @reg while @page is
+ * selected. Returns the frame length, 0 if @reg is already reachable.
+ */
+static inline unsigned int ad7293_frame_page(uint8_t *buf, uint8_t page,
+					     unsigned int reg)
+{
+	if (page == ad7293_reg_page(reg))
+		return 0;
+
+	buf[0] = AD7293_PAGE_SELECT_ADDR;
+	buf[1] = ad7293_reg_page(reg);
+
+	return 2;
+}
+
+/* Fill @buf with a write of @val to @reg, returns the frame length */
+static inline unsigned int ad7293_frame_write(uint8_t *buf, unsigned int reg,
+					      uint16_t val)
+{
+	unsigned int len = ad7293_reg_len(reg);
+
+	buf[0] = ad7293_reg_addr(reg);
+
+	if (len == 1) {
+		buf[1] = val;
+	} else {
+		buf[1] = val >> 8;
+		buf[2] = val;
+	}
+
+	return len + 1;
+}
+
+/* Fill @buf with a read of @reg, returns the frame length */
+static inline unsigned int ad7293_frame_read(uint8_t *buf, unsigned int reg)
+{
+	unsigned int len = ad7293_reg_len(reg), i;
+
+	buf[0] = AD7293_READ | ad7293_reg_addr(reg);
+
+	for (i = 1; i <= len; i++)
+		buf[i] = 0;
+
+	return len + 1;
+}
+
+/* Value of @reg clocked back in a frame built by ad7293_frame_read() */
+static inline uint16_t ad7293_frame_val(const uint8_t *buf, unsigned int reg)
+{
+	if (ad7293_reg_len(reg) == 1)
+		return buf[1];
+
+	return (uint16_t)(buf[1] << 8 | buf[2]);
+}
+
+/*
+ * Everything needed to convert a channel and watch its result: result,
+ * offset and window registers, sequencer register and bit, and the sensor
+ * bandgap it depends on. Scans and single reads OR these together, so no
+ * channel type needs its own path.
+ */
+struct ad7293_ch_desc {
+	const char *name;
+	uint8_t page;
+	uint8_t addr;
+	uint8_t offset_page;
+	/* Indexed by enum ad7293_limit, all 0 for the DAC outputs */
+	uint8_t limit_page[AD7293_NUM_LIMITS];
+	/*
+	 * Sequencer register on page AD7293_SEQ_PAGE, 0 for the channels the
+	 * sequencer does not convert: the DAC outputs and supply monitors.
+	 */
+	uint8_t seq_addr;
+	uint16_t seq_bit;
+	/* VINx inputs, whose filter adds to the conversion latency */
+	uint8_t vin_bit;
+	uint8_t tsense_bg;
+	uint8_t isense_bg;
+	uint8_t rs_bg;
+};
+
+#define AD7293_CH_REGS(_name, _page, _addr)				\
+	.name = (_name), .page = (_page), .addr = (_addr),		\
+	.offset_page = (_page) + AD7293_OFFSET_PAGES,			\
+	.limit_page = {							\
+		(_page) + AD7293_LIMIT_PAGES + 2 * AD7293_LIMIT_HIGH,	\
+		(_page) + AD7293_LIMIT_PAGES + 2 * AD7293_LIMIT_LOW,	\
+		(_page) + AD7293_LIMIT_PAGES + 2 * AD7293_LIMIT_HYST,	\
+		(_page) + AD7293_LIMIT_PAGES + 2 * AD7293_LIMIT_MIN,	\
+		(_page) + AD7293_LIMIT_PAGES + 2 * AD7293_LIMIT_MAX,	\
+	}
+
+#define AD7293_CH_DESC_VIN(_ch) {					\
+	AD7293_CH_REGS("vin" #_ch, 0x0, 0x10 + (_ch)),			\
+	.seq_addr = 0x10, .seq_bit = 1U << (_ch),			\
+	.vin_bit = 1U << (_ch),						\
+}
+
+#define AD7293_CH_DESC_ISENSE(_ch) {					\
+	AD7293_CH_REGS("isense" #_ch, 0x0, 0x28 + (_ch)),		\
+	.seq_addr = 0x11, .seq_bit = 1U << ((_ch) + 8),			\
+	.isense_bg = 1U << (_ch),					\
+}
+
+#define AD7293_CH_DESC_TSENSE(_name, _ch) {				\
+	AD7293_CH_REGS(_name, 0x0, 0x20 + (_ch)),			\
+	.seq_addr = 0x11, .seq_bit = 1U << (_ch),			\
+	.tsense_bg = 1U << (_ch),					\
+}
+
+#define AD7293_CH_DESC_SUPPLY(_name, _ch) {				\
+	AD7293_CH_REGS(_name, 0x1, 0x10 + (_ch)),			\
+}
+
+/*
+ * RSX_MON_BI_VOUTX_SEQ follows ISENSEX_TSENSEX_SEQ: the type named first
+ * takes the upper byte.
+ */
+#define AD7293_CH_DESC_BI_VOUT_MON(_ch) {				\
+	AD7293_CH_REGS("bi_vout" #_ch "_mon", 0x1, 0x14 + (_ch)),	\
+	.seq_addr = 0x12, .seq_bit = 1U << (_ch),			\
+}
+
+#define AD7293_CH_DESC_RS_MON(_ch) {					\
+	AD7293_CH_REGS("rs" #_ch "_mon", 0x1, 0x28 + (_ch)),		\
+	.seq_addr = 0x12, .seq_bit = 1U << ((_ch) + 8),			\
+	.rs_bg = 1U << (_ch),						\
+}
+
+#define AD7293_CH_DESC_DAC(_name, _ch) {				\
+	.name = (_name), .page = 0x0, .addr = 0x30 + (_ch),		\
+	.offset_page = AD7293_OFFSET_PAGES,				\
+}
+
+/* Index of the first channel of each type in ad7293_ch_descs[] */
+#define AD7293_CH_VIN0				0
+#define AD7293_CH_ISENSE0			(AD7293_CH_VIN0 + AD7293_NUM_VINX)
+#define AD7293_CH_TSENSE0			(AD7293_CH_ISENSE0 +		\
+						 AD7293_NUM_ISENSE)
+#define AD7293_CH_SUPPLY0			(AD7293_CH_TSENSE0 +		\
+						 AD7293_NUM_TSENSE)
+#define AD7293_CH_BI_VOUT_MON0			(AD7293_CH_SUPPLY0 +		\
+						 AD7293_NUM_SUPPLY)
+#define AD7293_CH_RS_MON0			(AD7293_CH_BI_VOUT_MON0 +	\
+						 AD7293_NUM_BI_VOUT_MON)
+#define AD7293_CH_DAC0				(AD7293_CH_RS_MON0 +		\
+						 AD7293_NUM_RS_MON)
+#define AD7293_NUM_CH				(AD7293_CH_DAC0 + AD7293_NUM_DAC)
+
+/*
+ * ADC inputs in scan order, VINx then ISENSE then TSENSE, then the page 1
+ * monitors and last the DAC outputs, unipolar first.
+ */
+static const struct ad7293_ch_desc ad7293_ch_descs[AD7293_NUM_CH] = {
+	AD7293_CH_DESC_VIN(0),
+	AD7293_CH_DESC_VIN(1),
+	AD7293_CH_DESC_VIN(2),
+	AD7293_CH_DESC_VIN(3),
+	AD7293_CH_DESC_ISENSE(0),
+	AD7293_CH_DESC_ISENSE(1),
+	AD7293_CH_DESC_ISENSE(2),
+	AD7293_CH_DESC_ISENSE(3),
+	AD7293_CH_DESC_TSENSE("tsense_int", 0),
+	AD7293_CH_DESC_TSENSE("tsense_d0", 1),
+	AD7293_CH_DESC_TSENSE("tsense_d1", 2),
+	AD7293_CH_DESC_SUPPLY("avdd", 0),
+	AD7293_CH_DESC_SUPPLY("dacvdd_uni", 1),
+	AD7293_CH_DESC_SUPPLY("dacvdd_bi", 2),
+	AD7293_CH_DESC_SUPPLY("avss", 3),
+	AD7293_CH_DESC_BI_VOUT_MON(0),
+	AD7293_CH_DESC_BI_VOUT_MON(1),
+	AD7293_CH_DESC_BI_VOUT_MON(2),
+	AD7293_CH_DESC_BI_VOUT_MON(3),
+	AD7293_CH_DESC_RS_MON(0),
+	AD7293_CH_DESC_RS_MON(1),
+	AD7293_CH_DESC_RS_MON(2),
+	AD7293_CH_DESC_RS_MON(3),
+	AD7293_CH_DESC_DAC("uni_vout0", 0),
+	AD7293_CH_DESC_DAC("uni_vout1", 1),
+	AD7293_CH_DESC_DAC("uni_vout2", 2),
+	AD7293_CH_DESC_DAC("uni_vout3", 3),
+	AD7293_CH_DESC_DAC("bi_vout0", 4),
+	AD7293_CH_DESC_DAC("bi_vout1", 5),
+	AD7293_CH_DESC_DAC("bi_vout2", 6),
+	AD7293_CH_DESC_DAC("bi_vout3", 7),
+};
+
+/* Number of channels of a type, 0 for an invalid type */
+static inline unsigned int ad7293_ch_num(enum ad7293_ch_type type)
+{
+	switch (type) {
+	case AD7293_ADC_VINX:
+		return AD7293_NUM_VINX;
+	case AD7293_ADC_TSENSE:
+		return AD7293_NUM_TSENSE;
+	case AD7293_ADC_ISENSE:
+		return AD7293_NUM_ISENSE;
+	case AD7293_DAC:
+		return AD7293_NUM_DAC;
+	case AD7293_ADC_SUPPLY:
+		return AD7293_NUM_SUPPLY;
+	case AD7293_ADC_BI_VOUT_MON:
+		return AD7293_NUM_BI_VOUT_MON;
+	case AD7293_ADC_RS_MON:
+		return AD7293_NUM_RS_MON;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Index of a channel in ad7293_ch_descs[], which for the ADC inputs is also
+ * their scan index. @ch must be below ad7293_ch_num(@type).
+ */
+static inline unsigned int ad7293_ch_index(enum ad7293_ch_type type,
+					   unsigned int ch)
+{
+	switch (type) {
+	case AD7293_ADC_ISENSE:
+		return AD7293_CH_ISENSE0 + ch;
+	case AD7293_ADC_TSENSE:
+		return AD7293_CH_TSENSE0 + ch;
+	case AD7293_ADC_SUPPLY:
+		return AD7293_CH_SUPPLY0 + ch;
+	case AD7293_ADC_BI_VOUT_MON:
+		return AD7293_CH_BI_VOUT_MON0 + ch;
+	case AD7293_ADC_RS_MON:
+		return AD7293_CH_RS_MON0 + ch;
+	case AD7293_DAC:
+		return AD7293_CH_DAC0 + ch;
+	default:
+		return AD7293_CH_VIN0 + ch;
+	}
+}
+
+static inline const struct ad7293_ch_desc *ad7293_dac_desc(unsigned int ch)
+{
+	return &ad7293_ch_descs[AD7293_CH_DAC0 + ch];
+}
+
+static inline unsigned int ad7293_ch_result(const struct ad7293_ch_desc *desc)
+{
+	return ad7293_reg(AD7293_R2B, desc->page, desc->addr);
+}
+
+static inline unsigned int ad7293_ch_offset(const struct ad7293_ch_desc *desc)
+{
+	return ad7293_reg(AD7293_R1B, desc->offset_page, desc->addr);
+}
+
+static inline unsigned int ad7293_ch_seq(const struct ad7293_ch_desc *desc)
+{
+	return ad7293_reg(AD7293_R2B, AD7293_SEQ_PAGE, desc->seq_addr);
+}
+
+/* Whether the channel has limit, hysteresis and min/max registers */
+static inline int ad7293_ch_has_limits(const struct ad7293_ch_desc *desc)
+{
+	return desc->limit_page[AD7293_LIMIT_HIGH] != 0;
+}
+
+/* Window register of a channel, which must have them */
+static inline unsigned int ad7293_ch_limit(const struct ad7293_ch_desc *desc,
+					   enum ad7293_limit limit)
+{
+	return ad7293_reg(AD7293_R2B, desc->limit_page[limit], desc->addr);
+}
+
+#endif /* __AD7293_CORE_H__ */
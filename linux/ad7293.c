@@ -7,21 +7,47 @@
 
 #include <linux/bitfield.h>
 #include <linux/bits.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/device.h>
+#include <linux/devm-helpers.h>
 #include <linux/gpio/consumer.h>
+#include <linux/gpio/driver.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/buffer-dmaengine.h>
+#include <linux/iio/consumer.h>
+#include <linux/iio/driver.h>
+#include <linux/iio/events.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/machine.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/kstrtox.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/mod_devicetable.h>
 #include <linux/module.h>
+#include <linux/pm_runtime.h>
+#include <linux/property.h>
+#include <linux/ptp_clock_kernel.h>
 #include <linux/regulator/consumer.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+#include <linux/uaccess.h>
+#include <linux/units.h>
+#include <linux/workqueue.h>
+#include <linux/spi/offload/consumer.h>
 #include <linux/spi/spi.h>
+#include <linux/unaligned.h>
 
-#include <asm/unaligned.h>
-
-#define AD7293_R1B				BIT(16)
-#define AD7293_R2B				BIT(17)
-#define AD7293_PAGE_ADDR_MSK			GENMASK(15, 8)
-#define AD7293_PAGE(x)				FIELD_PREP(AD7293_PAGE_ADDR_MSK, x)
+#include "../common/ad7293_core.h"
+#include "ad7293.h"
 
 /* AD7293 Register Map Common */
 #define AD7293_REG_NO_OP			(AD7293_R1B | AD7293_PAGE(0x0) | 0x0)
@@ -54,6 +80,7 @@
 #define AD7293_REG_BI_VOUT3			(AD7293_R2B | AD7293_PAGE(0x0) | 0x37)
 
 /* AD7293 Register Map Page 0x2 */
+#define AD7293_REG_DIGITAL_INOUT		(AD7293_R2B | AD7293_PAGE(0x2) | 0x10)
 #define AD7293_REG_DIGITAL_OUT_EN		(AD7293_R2B | AD7293_PAGE(0x2) | 0x11)
 #define AD7293_REG_DIGITAL_INOUT_FUNC		(AD7293_R2B | AD7293_PAGE(0x2) | 0x12)
 #define AD7293_REG_DIGITAL_FUNC_POL		(AD7293_R2B | AD7293_PAGE(0x2) | 0x13)
@@ -105,36 +132,294 @@
 #define AD7293_REG_BI_VOUT2_OFFSET		(AD7293_R1B | AD7293_PAGE(0xE) | 0x36)
 #define AD7293_REG_BI_VOUT3_OFFSET		(AD7293_R1B | AD7293_PAGE(0xE) | 0x37)
 
-/* AD7293 Miscellaneous Definitions */
-#define AD7293_READ				BIT(7)
-#define AD7293_TRANSF_LEN_MSK			GENMASK(17, 16)
+/* AD7293 Register Map Page 0xF */
+#define AD7293_REG_AVDD_OFFSET			(AD7293_R1B | AD7293_PAGE(0xF) | 0x10)
+#define AD7293_REG_DACVDD_UNI_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x11)
+#define AD7293_REG_DACVDD_BI_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x12)
+#define AD7293_REG_AVSS_OFFSET			(AD7293_R1B | AD7293_PAGE(0xF) | 0x13)
+#define AD7293_REG_BI_VOUT0_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x14)
+#define AD7293_REG_BI_VOUT1_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x15)
+#define AD7293_REG_BI_VOUT2_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x16)
+#define AD7293_REG_BI_VOUT3_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x17)
+#define AD7293_REG_RS0_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x28)
+#define AD7293_REG_RS1_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x29)
+#define AD7293_REG_RS2_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x2A)
+#define AD7293_REG_RS3_MON_OFFSET		(AD7293_R1B | AD7293_PAGE(0xF) | 0x2B)
 
-#define AD7293_REG_ADDR_MSK			GENMASK(7, 0)
+/* AD7293 Miscellaneous Definitions */
 #define AD7293_REG_VOUT_OFFSET_MSK		GENMASK(5, 4)
 #define AD7293_REG_DATA_RAW_MSK			GENMASK(15, 4)
 #define AD7293_REG_VINX_RANGE_GET_CH_MSK(x, ch)	(((x) >> (ch)) & 0x1)
 #define AD7293_REG_VINX_RANGE_SET_CH_MSK(x, ch)	(((x) & 0x1) << (ch))
+#define AD7293_REG_ISENSE_GAIN_MSK(ch)		(0xf << (4 * (ch)))
+#define AD7293_REG_CONV_DELAY_MSK		GENMASK(2, 0)
 #define AD7293_CHIP_ID				0x18
+#define AD7293_ADC_RESOLUTION			12
+#define AD7293_REFADC_MV			1250
+#define AD7293_TSENSE_SCALE_MILLI_C		125
+#define AD7293_CONV_CMD_VAL			0x82
+
+/* Conversion time of a single sequenced channel */
+#define AD7293_CONV_TIME_NS			2000
+/* Additional settling time of a VINx input with its filter enabled */
+#define AD7293_FILTER_SETTLE_NS			4000
+/* Margin added on top of the expected latency before giving up */
+#define AD7293_CONV_TIMEOUT_US			1000
+
+/* Settling time of the reference and sensor bandgaps once enabled */
+#define AD7293_BG_SETTLE_US			1000
+#define AD7293_TSENSE_BG_SETTLE_US		9000
+#define AD7293_ISENSE_BG_SETTLE_US		2000
+
+/*
+ * Idle time after which the sensor bandgaps are parked and the DACs that are
+ * not driving their outputs are snoozed.
+ */
+#define AD7293_AUTOSUSPEND_DELAY_MS		1000
+#define AD7293_DAC_SNOOZE_MSK			GENMASK(3, 0)
+
+/*
+ * Highest SPI clock rates supported by the device. Reads are limited by the
+ * SDO output delay and hence slower than writes. The rates actually used are
+ * checked at probe and halved until the device responds correctly, down to
+ * the rate known to work on every board.
+ */
+#define AD7293_SPI_WRITE_MAX_HZ			20000000U
+#define AD7293_SPI_READ_MAX_HZ			10000000U
+#define AD7293_SPI_SAFE_HZ			1000000U
+#define AD7293_SPI_TEST_PAGE			0x3
+
+#define AD7293_NUM_GPIO				8
+#define AD7293_DAC_MAX_CODE			GENMASK(11, 0)
+#define AD7293_ADC_MAX_CODE			GENMASK(AD7293_ADC_RESOLUTION - 1, 0)
+#define AD7293_OFFSET_MAX			GENMASK(7, 0)
+#define AD7293_NUM_ADC_CH			(AD7293_NUM_VINX +		\
+						 AD7293_NUM_ISENSE +		\
+						 AD7293_NUM_TSENSE)
+/* Scan rate of an offloaded capture until userspace picks one */
+#define AD7293_OFFLOAD_DEFAULT_HZ		(10 * HZ_PER_KHZ)
+
+/*
+ * Offset calibration: conversions averaged per channel, channels that can be
+ * nulled with a zero input (VINx and ISENSE, by scan index) and version of
+ * the coefficient blob exchanged through debugfs.
+ */
+#define AD7293_CALIB_AVG_LOG2			4
+#define AD7293_CALIB_CH_MSK			GENMASK(AD7293_NUM_VINX +	\
+							AD7293_NUM_ISENSE - 1, 0)
+#define AD7293_CALIB_VERSION			1
+
+/*
+ * Worst case number of register writes issued while applying the firmware
+ * configuration: digital pin functions (2), VINx range (2), VINx filter,
+ * conversion delay, ISENSE gain, one offset register per channel and the DAC
+ * codes followed by DAC_EN.
+ */
+#define AD7293_INIT_SEQ_MAX			(7 + AD7293_NUM_VINX +		\
+						 AD7293_NUM_ISENSE +		\
+						 AD7293_NUM_TSENSE +		\
+						 2 * AD7293_NUM_DAC + 1)
+
+static const int dac_offset_table[] = {0, 1, 2};
 
-enum ad7293_ch_type {
-	AD7293_ADC_VINX,
-	AD7293_ADC_TSENSE,
-	AD7293_ADC_ISENSE,
-	AD7293_DAC,
+/* ISENSE amplifier gain in V/V x 100, indexed by gain code */
+static const unsigned int isense_gain_table[] = {
+	100, 200, 400, 625, 800, 1250, 1600, 2500, 3200, 5000, 10000
 };
 
-enum ad7293_max_offset {
-	AD7293_TSENSE_MIN_OFFSET_CH = 4,
-	AD7293_ISENSE_MIN_OFFSET_CH = 7,
-	AD7293_VOUT_MIN_OFFSET_CH = 11,
-	AD7293_VOUT_MAX_OFFSET_CH = 18,
+/* VINx full scale range in mV, indexed by range code */
+static const unsigned int adc_range_table[] = {
+	4 * AD7293_REFADC_MV, 2 * AD7293_REFADC_MV, AD7293_REFADC_MV,
+	AD7293_REFADC_MV / 2
 };
 
-static const int dac_offset_table[] = {0, 1, 2};
+/* Delay inserted between two sequenced conversions, in microseconds */
+static const int conv_delay_table[] = {0, 2, 4, 8, 16, 32, 64, 128};
+
+/* Number of conversions averaged into one VINx or ISENSE result */
+static const int oversampling_table[] = {1, 2, 4, 8, 16, 32, 64};
+
+struct ad7293_reg_write {
+	unsigned int reg;
+	u16 val;
+};
+
+/*
+ * Software watchdog evaluated on every buffered scan. Thresholds are in raw
+ * codes and rates of change in raw codes per second, indexed by
+ * ad7293_watch_idx(). Events fire on the scan where a condition becomes true.
+ */
+struct ad7293_watch {
+	u32 value[4];
+	u8 enabled;
+	u8 asserted;
+	bool primed;
+	u16 prev_raw;
+	s64 prev_ts;
+};
+
+/* Sequencer registers, indexed by ad7293_seq_idx() */
+static const unsigned int ad7293_seq_regs[] = {
+	AD7293_REG_VINX_SEQ,
+	AD7293_REG_ISENSEX_TSENSEX_SEQ,
+};
+
+static unsigned int ad7293_seq_idx(const struct ad7293_ch_desc *desc)
+{
+	return desc->seq_addr - FIELD_GET(AD7293_REG_ADDR_MSK,
+					  AD7293_REG_VINX_SEQ);
+}
+
+/*
+ * Offset registers making up the calibration coefficients of a board, in
+ * the order they appear in the blob exchanged through debugfs. This includes
+ * the supply and monitor offsets on page 0xF, which have no IIO channel but
+ * are still worth carrying over from one calibration to the next.
+ */
+static const unsigned int ad7293_offset_regs[] = {
+	AD7293_REG_VIN0_OFFSET,
+	AD7293_REG_VIN1_OFFSET,
+	AD7293_REG_VIN2_OFFSET,
+	AD7293_REG_VIN3_OFFSET,
+	AD7293_REG_TSENSE_INT_OFFSET,
+	AD7293_REG_TSENSE_D0_OFFSET,
+	AD7293_REG_TSENSE_D1_OFFSET,
+	AD7293_REG_ISENSE0_OFFSET,
+	AD7293_REG_ISENSE1_OFFSET,
+	AD7293_REG_ISENSE2_OFFSET,
+	AD7293_REG_ISENSE3_OFFSET,
+	AD7293_REG_UNI_VOUT0_OFFSET,
+	AD7293_REG_UNI_VOUT1_OFFSET,
+	AD7293_REG_UNI_VOUT2_OFFSET,
+	AD7293_REG_UNI_VOUT3_OFFSET,
+	AD7293_REG_BI_VOUT0_OFFSET,
+	AD7293_REG_BI_VOUT1_OFFSET,
+	AD7293_REG_BI_VOUT2_OFFSET,
+	AD7293_REG_BI_VOUT3_OFFSET,
+	AD7293_REG_AVDD_OFFSET,
+	AD7293_REG_DACVDD_UNI_OFFSET,
+	AD7293_REG_DACVDD_BI_OFFSET,
+	AD7293_REG_AVSS_OFFSET,
+	AD7293_REG_BI_VOUT0_MON_OFFSET,
+	AD7293_REG_BI_VOUT1_MON_OFFSET,
+	AD7293_REG_BI_VOUT2_MON_OFFSET,
+	AD7293_REG_BI_VOUT3_MON_OFFSET,
+	AD7293_REG_RS0_MON_OFFSET,
+	AD7293_REG_RS1_MON_OFFSET,
+	AD7293_REG_RS2_MON_OFFSET,
+	AD7293_REG_RS3_MON_OFFSET,
+};
+
+struct ad7293_calib_blob {
+	__be16 chip_id;
+	u8 version;
+	u8 num;
+	u8 offset[ARRAY_SIZE(ad7293_offset_regs)];
+} __packed;
+
+/*
+ * Configuration registers saved across system sleep, grouped by page so they
+ * can be restored with a single page select per page. The DAC codes come
+ * last so that the outputs are only enabled once everything else is set.
+ */
+static const unsigned int ad7293_ctx_regs[] = {
+	AD7293_REG_DIGITAL_INOUT,
+	AD7293_REG_DIGITAL_OUT_EN,
+	AD7293_REG_DIGITAL_INOUT_FUNC,
+	AD7293_REG_DIGITAL_FUNC_POL,
+	AD7293_REG_GENERAL,
+	AD7293_REG_VINX_RANGE0,
+	AD7293_REG_VINX_RANGE1,
+	AD7293_REG_VINX_DIFF_SE,
+	AD7293_REG_VINX_FILTER,
+	AD7293_REG_BG_EN,
+	AD7293_REG_CONV_DELAY,
+	AD7293_REG_TSENSE_BG_EN,
+	AD7293_REG_ISENSE_BG_EN,
+	AD7293_REG_ISENSE_GAIN,
+	AD7293_REG_DAC_SNOOZE_O,
+	AD7293_REG_DAC_SNOOZE_1,
+	AD7293_REG_RSX_MON_BG_EN,
+	AD7293_REG_INTEGR_CL,
+	AD7293_REG_PA_ON_CTRL,
+	AD7293_REG_RAMP_TIME_0,
+	AD7293_REG_RAMP_TIME_1,
+	AD7293_REG_RAMP_TIME_2,
+	AD7293_REG_RAMP_TIME_3,
+	AD7293_REG_CL_FR_IT,
+	AD7293_REG_INTX_AVSS_AVDD,
+	AD7293_REG_VINX_SEQ,
+	AD7293_REG_ISENSEX_TSENSEX_SEQ,
+	AD7293_REG_RSX_MON_BI_VOUTX_SEQ,
+	AD7293_REG_VIN0_OFFSET,
+	AD7293_REG_VIN1_OFFSET,
+	AD7293_REG_VIN2_OFFSET,
+	AD7293_REG_VIN3_OFFSET,
+	AD7293_REG_TSENSE_INT_OFFSET,
+	AD7293_REG_TSENSE_D0_OFFSET,
+	AD7293_REG_TSENSE_D1_OFFSET,
+	AD7293_REG_ISENSE0_OFFSET,
+	AD7293_REG_ISENSE1_OFFSET,
+	AD7293_REG_ISENSE2_OFFSET,
+	AD7293_REG_ISENSE3_OFFSET,
+	AD7293_REG_UNI_VOUT0_OFFSET,
+	AD7293_REG_UNI_VOUT1_OFFSET,
+	AD7293_REG_UNI_VOUT2_OFFSET,
+	AD7293_REG_UNI_VOUT3_OFFSET,
+	AD7293_REG_BI_VOUT0_OFFSET,
+	AD7293_REG_BI_VOUT1_OFFSET,
+	AD7293_REG_BI_VOUT2_OFFSET,
+	AD7293_REG_BI_VOUT3_OFFSET,
+	AD7293_REG_AVDD_OFFSET,
+	AD7293_REG_DACVDD_UNI_OFFSET,
+	AD7293_REG_DACVDD_BI_OFFSET,
+	AD7293_REG_AVSS_OFFSET,
+	AD7293_REG_BI_VOUT0_MON_OFFSET,
+	AD7293_REG_BI_VOUT1_MON_OFFSET,
+	AD7293_REG_BI_VOUT2_MON_OFFSET,
+	AD7293_REG_BI_VOUT3_MON_OFFSET,
+	AD7293_REG_RS0_MON_OFFSET,
+	AD7293_REG_RS1_MON_OFFSET,
+	AD7293_REG_RS2_MON_OFFSET,
+	AD7293_REG_RS3_MON_OFFSET,
+	AD7293_REG_UNI_VOUT0,
+	AD7293_REG_UNI_VOUT1,
+	AD7293_REG_UNI_VOUT2,
+	AD7293_REG_UNI_VOUT3,
+	AD7293_REG_BI_VOUT0,
+	AD7293_REG_BI_VOUT1,
+	AD7293_REG_BI_VOUT2,
+	AD7293_REG_BI_VOUT3,
+	AD7293_REG_DAC_EN,
+};
+
+/*
+ * Operations whose latency is tracked in debugfs. Bucket 0 counts calls under
+ * 1 us, bucket i those in [2^(i - 1), 2^i) us and the last one everything
+ * above, which leaves room for bandgap and PM resume stalls.
+ */
+enum ad7293_lat_op {
+	AD7293_LAT_READ_VIN,
+	AD7293_LAT_READ_ISENSE,
+	AD7293_LAT_READ_TSENSE,
+	AD7293_LAT_READ_DAC,
+	AD7293_LAT_WRITE_DAC,
+	AD7293_LAT_CONFIG,
+	AD7293_LAT_SCAN,
+	AD7293_LAT_NUM
+};
 
-static const int isense_gain_table[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+#define AD7293_LAT_BUCKETS			24
 
-static const int adc_range_table[] = {0, 1, 2, 3};
+static const char * const ad7293_lat_names[AD7293_LAT_NUM] = {
+	[AD7293_LAT_READ_VIN] = "read_voltage",
+	[AD7293_LAT_READ_ISENSE] = "read_current",
+	[AD7293_LAT_READ_TSENSE] = "read_temp",
+	[AD7293_LAT_READ_DAC] = "read_dac",
+	[AD7293_LAT_WRITE_DAC] = "write_dac",
+	[AD7293_LAT_CONFIG] = "config",
+	[AD7293_LAT_SCAN] = "scan",
+};
 
 struct ad7293_state {
 	struct spi_device *spi;
@@ -143,23 +428,139 @@ struct ad7293_state {
 	struct gpio_desc *gpio_reset;
 	struct regulator *reg_avdd;
 	struct regulator *reg_vdrive;
+	u32 read_hz;
+	u32 write_hz;
 	u8 page_select;
+	u8 dac_en;
+	/* Digital pins: output levels, output enables and alternate functions */
+	struct gpio_chip gc;
+	u16 gpio_out;
+	u16 gpio_out_en;
+	u16 gpio_func;
+	/* Function pin carrying BUSY, 0 if none */
+	u16 busy_func;
+	/* BUSY interrupt requested, only meaningful while its pin is routed */
+	bool busy_irq;
+	u16 bg_en;
+	u16 tsense_bg;
+	u16 isense_bg;
+	bool bg_parked;
+	/* Duration of the last runtime resume, reported through debugfs */
+	u32 resume_cost_us;
+	/* Optional periodic check of the cached page against the device */
+	struct delayed_work page_work;
+	u32 page_check_ms;
+	u32 page_mismatch;
+	/* Read back DAC settings in the same SPI message they are written */
+	bool verify_writes;
+	u32 verify_fail;
+	/*
+	 * Page select frames sent and register reads issued, for debugging the
+	 * bus cost of an operation on a live system.
+	 */
+	u32 page_switches;
+	u32 reg_reads;
+	/* Latency histograms, by ad7293_lat_op, taken outside of the lock */
+	spinlock_t lat_lock;
+	u32 lat_hist[AD7293_LAT_NUM][AD7293_LAT_BUCKETS];
+	u8 conv_delay;
+	u8 vin_filter;
+	u8 vin_diff;
+	u8 vin_range[AD7293_NUM_VINX];
+	u8 isense_gain[AD7293_NUM_ISENSE];
+	/* log2 of the oversampling ratio of each ADC channel, by scan index */
+	u8 osr[AD7293_NUM_ADC_CH];
+	/* Sequencer registers content, by ad7293_seq_idx() */
+	u16 seq[ARRAY_SIZE(ad7293_seq_regs)];
+	u32 isense_shunt_uohm[AD7293_NUM_ISENSE];
+	/* IIO_VAL_INT_PLUS_NANO scales, computed once from the tables above */
+	int vin_scale[ARRAY_SIZE(adc_range_table)][2];
+	int isense_scale[AD7293_NUM_ISENSE][ARRAY_SIZE(isense_gain_table)][2];
+	struct completion conv_done;
+	/*
+	 * Latest result of each ADC channel, indexed by scan index and kept for
+	 * consumers that cannot sleep.
+	 */
+	seqlock_t latest_lock;
+	unsigned long latest_valid;
+	u16 latest_raw[AD7293_NUM_ADC_CH];
+	s64 latest_ts[AD7293_NUM_ADC_CH];
+	struct ad7293_watch watch[AD7293_NUM_ADC_CH];
+	/* Register snapshot taken on system suspend, replayed on resume */
+	struct ad7293_reg_write ctx[ARRAY_SIZE(ad7293_ctx_regs)];
+	/* Supplies turned off by system suspend and not restored yet */
+	bool supplies_off;
+	unsigned int scan_num;
+	/*
+	 * Multi-rate capture: a channel is converted on one trigger out of
+	 * scan_div and repeats its last result in between. scan_left counts
+	 * the triggers until it is due and scan_mask holds the channels the
+	 * scan message and the sequencer are both set up for, 0 if unknown.
+	 */
+	u16 scan_div[AD7293_NUM_ADC_CH];
+	u16 scan_left[AD7293_NUM_ADC_CH];
+	unsigned long scan_mask;
+	struct spi_message scan_msg;
+	struct spi_transfer scan_xfers[AD7293_NUM_ADC_CH + 1];
+	struct ptp_system_timestamp scan_sts;
+	struct {
+		__be16 channels[AD7293_NUM_ADC_CH];
+		s64 timestamp __aligned(8);
+	} scan;
+	/*
+	 * SPI offload, when the controller has one: the scan message is
+	 * replayed by a periodic trigger and the results stream into a DMA
+	 * buffer that userspace maps, without going through the CPU.
+	 */
+	struct spi_offload *offload;
+	struct spi_offload_trigger *offload_trigger;
+	u64 offload_trigger_hz;
+	bool offload_running;
+	struct spi_message offload_msg;
+	struct spi_transfer offload_xfers[AD7293_NUM_ADC_CH + 1];
 	u8 data[3] ____cacheline_aligned;
+	u8 readback[3];
+	u8 scan_cmd[3];
+	u8 scan_tx[AD7293_NUM_ADC_CH][3];
+	u8 scan_rx[AD7293_NUM_ADC_CH][3];
+	/* One 24-bit word per result read, as the offload stream expects */
+	u32 offload_tx[AD7293_NUM_ADC_CH];
 };
 
+static int ad7293_spi_write_data(struct ad7293_state *st, unsigned int len)
+{
+	struct spi_transfer t = {
+		.tx_buf = &st->data[0],
+		.len = len,
+		.speed_hz = st->write_hz,
+	};
+	int ret;
+
+	ret = spi_sync_transfer(st->spi, &t, 1);
+	if (ret)
+		/* A failed frame may have been latched as a page select */
+		st->page_select = AD7293_PAGE_INVALID;
+
+	return ret;
+}
+
 static int ad7293_page_select(struct ad7293_state *st, unsigned int reg)
 {
+	unsigned int len;
 	int ret;
 
-	if (st->page_select != FIELD_GET(AD7293_PAGE_ADDR_MSK, reg)) {
-		st->data[0] = FIELD_GET(AD7293_REG_ADDR_MSK, AD7293_REG_PAGE_SELECT);
-		st->data[1] = FIELD_GET(AD7293_PAGE_ADDR_MSK, reg);
+	len = ad7293_frame_page(st->data, st->page_select, reg);
+	if (len) {
+		/* An offloaded capture needs the result page to stay selected */
+		if (st->offload_running)
+			return -EBUSY;
 
-		ret = spi_write(st->spi, &st->data[0], 2);
+		st->page_switches++;
+		ret = ad7293_spi_write_data(st, len);
 		if (ret)
 			return ret;
 
-		st->page_select = FIELD_GET(AD7293_PAGE_ADDR_MSK, reg);
+		st->page_select = ad7293_reg_page(reg);
 	}
 
 	return 0;
@@ -169,31 +570,60 @@ static int __ad7293_spi_read(struct ad7293_state *st, unsigned int reg,
 			     u16 *val)
 {
 	int ret;
-	unsigned int length;
 	struct spi_transfer t = {0};
 
-	length = FIELD_GET(AD7293_TRANSF_LEN_MSK, reg);
-
 	ret = ad7293_page_select(st, reg);
 	if (ret)
 		return ret;
 
-	st->data[0] = AD7293_READ | FIELD_GET(AD7293_REG_ADDR_MSK, reg);
-	st->data[1] = 0x0;
-	st->data[2] = 0x0;
-
 	t.tx_buf = &st->data[0];
 	t.rx_buf = &st->data[0];
-	t.len = length + 1;
+	t.len = ad7293_frame_read(st->data, reg);
+	t.speed_hz = st->read_hz;
 
+	st->reg_reads++;
 	ret = spi_sync_transfer(st->spi, &t, 1);
-	if (ret)
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
 		return ret;
+	}
 
-	if (length == 1)
-		*val = st->data[1];
-	else
-		*val = get_unaligned_be16(&st->data[1]);
+	*val = ad7293_frame_val(st->data, reg);
+
+	return 0;
+}
+
+/*
+ * Read the page register back and resynchronize the cache with it. The page
+ * select register is common to all pages, so it is read without selecting
+ * any page first.
+ */
+static int __ad7293_page_verify(struct ad7293_state *st)
+{
+	struct spi_transfer t = {
+		.tx_buf = &st->data[0],
+		.rx_buf = &st->data[0],
+		.speed_hz = st->read_hz,
+	};
+	int ret;
+
+	t.len = ad7293_frame_read(st->data, AD7293_REG_PAGE_SELECT);
+
+	ret = spi_sync_transfer(st->spi, &t, 1);
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
+		return ret;
+	}
+
+	if (st->page_select != AD7293_PAGE_INVALID &&
+	    st->page_select != st->data[1]) {
+		st->page_mismatch++;
+		dev_warn_ratelimited(&st->spi->dev,
+				     "page out of sync: cached %u, device %u\n",
+				     st->page_select, st->data[1]);
+	}
+
+	st->page_select = st->data[1];
 
 	return 0;
 }
@@ -214,22 +644,82 @@ static int __ad7293_spi_write(struct ad7293_state *st, unsigned int reg,
 			      u16 val)
 {
 	int ret;
-	unsigned int length;
 
-	length = FIELD_GET(AD7293_TRANSF_LEN_MSK, reg);
+	ret = ad7293_page_select(st, reg);
+	if (ret)
+		return ret;
+
+	return ad7293_spi_write_data(st, ad7293_frame_write(st->data, reg, val));
+}
+
+/*
+ * Write a register and read it back right after, chip select being toggled in
+ * between, so the check costs one extra frame rather than a second message.
+ */
+static int __ad7293_spi_write_verify(struct ad7293_state *st, unsigned int reg,
+				     u16 val)
+{
+	struct spi_transfer t[2] = {
+		{
+			.tx_buf = &st->data[0],
+			.cs_change = 1,
+			.speed_hz = st->write_hz,
+		}, {
+			.tx_buf = &st->readback[0],
+			.rx_buf = &st->readback[0],
+			.speed_hz = st->read_hz,
+		},
+	};
+	u16 readback;
+	int ret;
 
 	ret = ad7293_page_select(st, reg);
 	if (ret)
 		return ret;
 
-	st->data[0] = FIELD_GET(AD7293_REG_ADDR_MSK, reg);
+	t[0].len = ad7293_frame_write(st->data, reg, val);
+	t[1].len = ad7293_frame_read(st->readback, reg);
 
-	if (length == 1)
-		st->data[1] = val;
-	else
-		put_unaligned_be16(val, &st->data[1]);
+	ret = spi_sync_transfer(st->spi, t, ARRAY_SIZE(t));
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
+		return ret;
+	}
+
+	readback = ad7293_frame_val(st->readback, reg);
+
+	if (readback != val) {
+		st->verify_fail++;
+		dev_err_ratelimited(&st->spi->dev,
+				    "write to 0x%05x failed: wrote 0x%04x, read 0x%04x\n",
+				    reg, val, readback);
+		return -EIO;
+	}
+
+	return 0;
+}
 
-	return spi_write(st->spi, &st->data[0], length + 1);
+/* DAC settings bias the PA gates, so they are checked when requested */
+static int __ad7293_dac_write(struct ad7293_state *st, unsigned int reg,
+			      u16 val)
+{
+	if (st->verify_writes)
+		return __ad7293_spi_write_verify(st, reg, val);
+
+	return __ad7293_spi_write(st, reg, val);
+}
+
+static int __ad7293_dac_update_bits(struct ad7293_state *st, unsigned int reg,
+				    u16 mask, u16 val)
+{
+	int ret;
+	u16 data;
+
+	ret = __ad7293_spi_read(st, reg, &data);
+	if (ret)
+		return ret;
+
+	return __ad7293_dac_write(st, reg, (data & ~mask) | (val & mask));
 }
 
 static int ad7293_spi_write(struct ad7293_state *st, unsigned int reg,
@@ -271,32 +761,126 @@ static int ad7293_spi_update_bits(struct ad7293_state *st, unsigned int reg,
 	return ret;
 }
 
-static int ad7293_adc_get_scale(struct ad7293_state *st, unsigned int ch,
-				u16 *range)
+/*
+ * Issue a list of register writes as a single SPI message. Every register
+ * access keeps its own chip select frame and page select frames are only
+ * inserted when the page changes, so callers should group @seq by page.
+ */
+static int __ad7293_spi_write_seq(struct ad7293_state *st,
+				  const struct ad7293_reg_write *seq,
+				  unsigned int num)
 {
+	struct spi_transfer *xfers;
+	unsigned int i, n = 0, len;
+	u8 page = st->page_select, *buf;
 	int ret;
-	u16 data;
 
-	mutex_lock(&st->lock);
+	if (!num)
+		return 0;
 
-	ret = __ad7293_spi_read(st, AD7293_REG_VINX_RANGE1, &data);
-	if (ret)
-		goto exit;
+	xfers = kcalloc(2 * num, sizeof(*xfers), GFP_KERNEL);
+	if (!xfers)
+		return -ENOMEM;
 
-	*range = AD7293_REG_VINX_RANGE_GET_CH_MSK(data, ch);
+	/* Transfer buffers must be DMA safe, so keep them off the stack */
+	buf = kcalloc(2 * num, AD7293_FRAME_MAX_BYTES, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto free_xfers;
+	}
 
-	ret = __ad7293_spi_read(st, AD7293_REG_VINX_RANGE0, &data);
-	if (ret)
-		goto exit;
+	for (i = 0; i < num; i++) {
+		unsigned int reg = seq[i].reg;
+		u8 *tx = &buf[AD7293_FRAME_MAX_BYTES * n];
 
-	*range |= AD7293_REG_VINX_RANGE_GET_CH_MSK(data, ch) << 1;
+		len = ad7293_frame_page(tx, page, reg);
+		if (len) {
+			if (st->offload_running) {
+				ret = -EBUSY;
+				goto free_buf;
+			}
 
-exit:
-	mutex_unlock(&st->lock);
+			page = ad7293_reg_page(reg);
+
+			xfers[n].tx_buf = tx;
+			xfers[n].len = len;
+			xfers[n].cs_change = 1;
+			xfers[n].speed_hz = st->write_hz;
+			n++;
+			st->page_switches++;
+
+			tx = &buf[AD7293_FRAME_MAX_BYTES * n];
+		}
+
+		xfers[n].tx_buf = tx;
+		xfers[n].len = ad7293_frame_write(tx, reg, seq[i].val);
+		xfers[n].cs_change = 1;
+		xfers[n].speed_hz = st->write_hz;
+		n++;
+	}
+
+	xfers[n - 1].cs_change = 0;
+
+	ret = spi_sync_transfer(st->spi, xfers, n);
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
+		goto free_buf;
+	}
+
+	st->page_select = page;
+
+free_buf:
+	kfree(buf);
+free_xfers:
+	kfree(xfers);
 
 	return ret;
 }
 
+/*
+ * Precompute the scale of every range and gain code, so that reading or
+ * selecting a scale never involves any arithmetic or bus access. ISENSE
+ * scales are in mA and depend on the shunt resistor of each channel.
+ */
+static void ad7293_scale_init(struct ad7293_state *st)
+{
+	unsigned int ch, i;
+	u32 rem;
+	u64 tmp;
+
+	for (i = 0; i < ARRAY_SIZE(adc_range_table); i++) {
+		tmp = div_u64((u64)adc_range_table[i] * NANO,
+			      BIT(AD7293_ADC_RESOLUTION));
+		st->vin_scale[i][0] = div_u64_rem(tmp, NANO, &rem);
+		st->vin_scale[i][1] = rem;
+	}
+
+	for (ch = 0; ch < AD7293_NUM_ISENSE; ch++) {
+		for (i = 0; i < ARRAY_SIZE(isense_gain_table); i++) {
+			/* nV across the shunt, then nA through it */
+			tmp = div_u64((u64)AD7293_REFADC_MV * 100 * NANO,
+				      isense_gain_table[i] *
+				      BIT(AD7293_ADC_RESOLUTION));
+			tmp = div_u64(tmp * MICRO, st->isense_shunt_uohm[ch]);
+			st->isense_scale[ch][i][0] = div_u64_rem(tmp, NANO, &rem);
+			st->isense_scale[ch][i][1] = rem;
+		}
+	}
+}
+
+static int ad7293_find_scale(const int (*scale)[2], unsigned int num,
+			     int val, int val2)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		if (scale[i][0] == val && scale[i][1] == val2)
+			return i;
+	}
+
+	return -EINVAL;
+}
+
 static int ad7293_adc_set_scale(struct ad7293_state *st, unsigned int ch,
 				u16 range)
 {
@@ -311,6 +895,10 @@ static int ad7293_adc_set_scale(struct ad7293_state *st, unsigned int ch,
 
 	ret = __ad7293_spi_update_bits(st, AD7293_REG_VINX_RANGE0, ch_msk,
 				       AD7293_REG_VINX_RANGE_SET_CH_MSK((range >> 1), ch));
+	if (ret)
+		goto exit;
+
+	st->vin_range[ch] = range;
 
 exit:
 	mutex_unlock(&st->lock);
@@ -318,154 +906,172 @@ exit:
 	return ret;
 }
 
-static int ad7293_get_offset(struct ad7293_state *st, unsigned int ch,
-			     u16 *offset)
+static int ad7293_get_offset(struct ad7293_state *st,
+			     struct iio_chan_spec const *chan, u16 *offset)
 {
-	if (ch < AD7293_TSENSE_MIN_OFFSET_CH)
-		return ad7293_spi_read(st, AD7293_REG_VIN0_OFFSET + ch, offset);
-	else if (ch < AD7293_ISENSE_MIN_OFFSET_CH)
-		return ad7293_spi_read(st, AD7293_REG_TSENSE_INT_OFFSET + (ch - 4), offset);
-	else if (ch < AD7293_VOUT_MIN_OFFSET_CH)
-		return ad7293_spi_read(st, AD7293_REG_ISENSE0_OFFSET + (ch - 7), offset);
-	else if (ch <= AD7293_VOUT_MAX_OFFSET_CH)
-		return ad7293_spi_read(st, AD7293_REG_UNI_VOUT0_OFFSET + (ch - 11), offset);
+	int ret;
 
-	return -EINVAL;
+	if (!chan->output)
+		return ad7293_spi_read(st,
+				       ad7293_ch_offset(&ad7293_ch_descs[chan->scan_index]),
+				       offset);
+
+	ret = ad7293_spi_read(st, ad7293_ch_offset(ad7293_dac_desc(chan->channel)),
+			      offset);
+	if (ret)
+		return ret;
+
+	*offset = FIELD_GET(AD7293_REG_VOUT_OFFSET_MSK, *offset);
+
+	return 0;
 }
 
-static int ad7293_set_offset(struct ad7293_state *st, unsigned int ch,
-			     u16 offset)
+static int ad7293_set_offset(struct ad7293_state *st,
+			     struct iio_chan_spec const *chan, u16 offset)
 {
-	if (ch < AD7293_TSENSE_MIN_OFFSET_CH)
-		return ad7293_spi_write(st, AD7293_REG_VIN0_OFFSET + ch,
-					offset);
-	else if (ch < AD7293_ISENSE_MIN_OFFSET_CH)
-		return ad7293_spi_write(st,
-					AD7293_REG_TSENSE_INT_OFFSET +
-					(ch - AD7293_TSENSE_MIN_OFFSET_CH),
-					offset);
-	else if (ch < AD7293_VOUT_MIN_OFFSET_CH)
+	int ret;
+
+	if (!chan->output)
 		return ad7293_spi_write(st,
-					AD7293_REG_ISENSE0_OFFSET +
-					(ch - AD7293_ISENSE_MIN_OFFSET_CH),
+					ad7293_ch_offset(&ad7293_ch_descs[chan->scan_index]),
 					offset);
-	else if (ch <= AD7293_VOUT_MAX_OFFSET_CH)
-		return ad7293_spi_update_bits(st,
-					      AD7293_REG_UNI_VOUT0_OFFSET +
-					      (ch - AD7293_VOUT_MIN_OFFSET_CH),
-					      AD7293_REG_VOUT_OFFSET_MSK,
-					      FIELD_PREP(AD7293_REG_VOUT_OFFSET_MSK, offset));
 
-	return -EINVAL;
+	mutex_lock(&st->lock);
+	ret = __ad7293_dac_update_bits(st,
+				       ad7293_ch_offset(ad7293_dac_desc(chan->channel)),
+				       AD7293_REG_VOUT_OFFSET_MSK,
+				       FIELD_PREP(AD7293_REG_VOUT_OFFSET_MSK, offset));
+	mutex_unlock(&st->lock);
+
+	return ret;
 }
 
 static int ad7293_isense_set_scale(struct ad7293_state *st, unsigned int ch,
 				   u16 gain)
 {
-	unsigned int ch_msk = (0xf << (4 * ch));
+	int ret;
+
+	mutex_lock(&st->lock);
+	ret = __ad7293_spi_update_bits(st, AD7293_REG_ISENSE_GAIN,
+				       AD7293_REG_ISENSE_GAIN_MSK(ch),
+				       gain << (4 * ch));
+	if (!ret)
+		st->isense_gain[ch] = gain;
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+/*
+ * Time needed by the sequencer to convert @num_conv channels, @vin_mask being
+ * the VINx inputs taking part in the sequence.
+ */
+static unsigned int ad7293_conv_latency_us(struct ad7293_state *st,
+					   unsigned int num_conv,
+					   unsigned long vin_mask)
+{
+	unsigned int t_ns;
+
+	t_ns = num_conv * (AD7293_CONV_TIME_NS +
+			   conv_delay_table[st->conv_delay] * NSEC_PER_USEC);
+	t_ns += hweight_long(vin_mask & st->vin_filter) * AD7293_FILTER_SETTLE_NS;
 
-	return ad7293_spi_update_bits(st, AD7293_REG_ISENSE_GAIN, ch_msk,
-				      gain << (4 * ch));
+	return DIV_ROUND_UP(t_ns, NSEC_PER_USEC);
 }
 
-static int ad7293_isense_get_scale(struct ad7293_state *st, unsigned int ch,
-				   u16 *gain)
+/*
+ * Wait for the end of the conversion started by the last conversion command.
+ * The register map documents no conversion status bit, so the completion is
+ * only signalled when the pin set as BUSY is routed to its function and
+ * drives the interrupt. Otherwise the computed sequencer latency is waited out.
+ */
+static int __ad7293_wait_conversion(struct ad7293_state *st,
+				    unsigned int latency_us)
 {
-	int ret;
+	unsigned int timeout_us = latency_us + AD7293_CONV_TIMEOUT_US;
 
-	ret = ad7293_spi_read(st, AD7293_REG_ISENSE_GAIN, gain);
-	if (ret)
-		return ret;
+	if (st->busy_irq && (st->gpio_func & st->busy_func)) {
+		if (!wait_for_completion_timeout(&st->conv_done,
+						 usecs_to_jiffies(timeout_us)))
+			return -ETIMEDOUT;
 
-	*gain = (*gain >> (4 * ch)) & 0xf;
+		return 0;
+	}
 
-	return ret;
+	fsleep(latency_us);
+
+	return 0;
 }
 
-static int ad7293_dac_write_raw(struct ad7293_state *st, unsigned int ch,
-				u16 raw)
+static int ad7293_set_conv_delay(struct ad7293_state *st, unsigned int delay)
 {
+	unsigned int i;
 	int ret;
 
-	mutex_lock(&st->lock);
-
-	ret = __ad7293_spi_update_bits(st, AD7293_REG_DAC_EN, BIT(ch), BIT(ch));
-	if (ret)
-		goto exit;
+	for (i = 0; i < ARRAY_SIZE(conv_delay_table); i++) {
+		if (conv_delay_table[i] == delay)
+			break;
+	}
 
-	ret =  __ad7293_spi_write(st, AD7293_REG_UNI_VOUT0 + ch,
-				  FIELD_PREP(AD7293_REG_DATA_RAW_MSK, raw));
+	if (i == ARRAY_SIZE(conv_delay_table))
+		return -EINVAL;
 
-exit:
+	mutex_lock(&st->lock);
+	ret = __ad7293_spi_update_bits(st, AD7293_REG_CONV_DELAY,
+				       AD7293_REG_CONV_DELAY_MSK,
+				       FIELD_PREP(AD7293_REG_CONV_DELAY_MSK, i));
+	if (!ret)
+		st->conv_delay = i;
 	mutex_unlock(&st->lock);
 
 	return ret;
 }
 
-static int ad7293_ch_read_raw(struct ad7293_state *st, enum ad7293_ch_type type,
-			      unsigned int ch, u16 *raw)
+static int ad7293_vin_set_filter(struct ad7293_state *st, unsigned int ch,
+				 bool enable)
 {
 	int ret;
-	unsigned int reg_wr, reg_rd, data_wr;
-
-	switch (type) {
-	case AD7293_ADC_VINX:
-		reg_wr = AD7293_REG_VINX_SEQ;
-		reg_rd = AD7293_REG_VIN0 + ch;
-		data_wr = BIT(ch);
 
-		break;
-	case AD7293_ADC_TSENSE:
-		reg_wr = AD7293_REG_ISENSEX_TSENSEX_SEQ;
-		reg_rd = AD7293_REG_TSENSE_INT + ch;
-		data_wr = BIT(ch);
-
-		break;
-	case AD7293_ADC_ISENSE:
-		reg_wr = AD7293_REG_ISENSEX_TSENSEX_SEQ;
-		reg_rd = AD7293_REG_ISENSE_0 + ch;
-		data_wr = BIT(ch) << 8;
+	mutex_lock(&st->lock);
+	ret = __ad7293_spi_update_bits(st, AD7293_REG_VINX_FILTER, BIT(ch),
+				       enable ? BIT(ch) : 0);
+	if (!ret)
+		st->vin_filter = (st->vin_filter & ~BIT(ch)) | (enable << ch);
+	mutex_unlock(&st->lock);
 
-		break;
-	case AD7293_DAC:
-		reg_rd = AD7293_REG_UNI_VOUT0 + ch;
+	return ret;
+}
 
-		break;
-	default:
-		return -EINVAL;
-	}
+static int ad7293_vin_set_diff(struct ad7293_state *st, unsigned int ch,
+			       bool diff)
+{
+	int ret;
 
 	mutex_lock(&st->lock);
+	ret = __ad7293_spi_update_bits(st, AD7293_REG_VINX_DIFF_SE, BIT(ch),
+				       diff ? BIT(ch) : 0);
+	if (!ret)
+		st->vin_diff = (st->vin_diff & ~BIT(ch)) | (diff << ch);
+	mutex_unlock(&st->lock);
 
-	if (type != AD7293_DAC) {
-		if (type == AD7293_ADC_TSENSE) {
-			ret = __ad7293_spi_write(st, AD7293_REG_TSENSE_BG_EN,
-						 BIT(ch));
-			if (ret)
-				goto exit;
-
-			usleep_range(9000, 9900);
-		} else if (type == AD7293_ADC_ISENSE) {
-			ret = __ad7293_spi_write(st, AD7293_REG_ISENSE_BG_EN,
-						 BIT(ch));
-			if (ret)
-				goto exit;
+	return ret;
+}
 
-			usleep_range(2000, 7000);
-		}
+static int ad7293_dac_write_raw(struct ad7293_state *st, unsigned int ch,
+				u16 raw)
+{
+	int ret;
 
-		ret = __ad7293_spi_write(st, reg_wr, data_wr);
-		if (ret)
-			goto exit;
+	mutex_lock(&st->lock);
 
-		ret = __ad7293_spi_write(st, AD7293_REG_CONV_CMD, 0x82);
-		if (ret)
-			goto exit;
-	}
+	ret = __ad7293_dac_update_bits(st, AD7293_REG_DAC_EN, BIT(ch), BIT(ch));
+	if (ret)
+		goto exit;
 
-	ret = __ad7293_spi_read(st, reg_rd, raw);
+	st->dac_en |= BIT(ch);
 
-	*raw = FIELD_GET(AD7293_REG_DATA_RAW_MSK, *raw);
+	ret = __ad7293_dac_write(st, ad7293_ch_result(ad7293_dac_desc(ch)),
+				 FIELD_PREP(AD7293_REG_DATA_RAW_MSK, raw));
 
 exit:
 	mutex_unlock(&st->lock);
@@ -473,40 +1079,319 @@ exit:
 	return ret;
 }
 
-static int ad7293_read_raw(struct iio_dev *indio_dev,
-			   struct iio_chan_spec const *chan,
-			   int *val, int *val2, long info)
+/*
+ * Enable the sensor bandgaps in the given masks on top of those already
+ * running. Only bandgaps that were off pay the settling time, so repeated
+ * reads of the same sensors do not sleep.
+ */
+static int __ad7293_bg_enable(struct ad7293_state *st, u16 tsense, u16 isense)
 {
-	struct ad7293_state *st = iio_priv(indio_dev);
+	struct ad7293_reg_write seq[2];
+	unsigned int n = 0, settle_us = 0;
 	int ret;
-	u16 data;
 
-	switch (info) {
-	case IIO_CHAN_INFO_RAW:
-		switch (chan->type) {
-		case IIO_VOLTAGE:
-			if (chan->output)
-				ret =  ad7293_ch_read_raw(st, AD7293_DAC,
-							  chan->channel, &data);
-			else
-				ret =  ad7293_ch_read_raw(st, AD7293_ADC_VINX,
-							  chan->channel, &data);
+	tsense &= ~st->tsense_bg;
+	isense &= ~st->isense_bg;
 
-			break;
-		case IIO_CURRENT:
-			ret =  ad7293_ch_read_raw(st, AD7293_ADC_ISENSE,
-						  chan->channel, &data);
+	if (tsense) {
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_TSENSE_BG_EN,
+						      st->tsense_bg | tsense };
+		settle_us = AD7293_TSENSE_BG_SETTLE_US;
+	}
 
-			break;
-		case IIO_TEMP:
-			ret =  ad7293_ch_read_raw(st, AD7293_ADC_TSENSE,
-						  chan->channel, &data);
+	if (isense) {
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_ISENSE_BG_EN,
+						      st->isense_bg | isense };
+		settle_us = max(settle_us, AD7293_ISENSE_BG_SETTLE_US);
+	}
 
-			break;
-		default:
-			return -EINVAL;
+	if (!n)
+		return 0;
+
+	ret = __ad7293_spi_write_seq(st, seq, n);
+	if (ret)
+		return ret;
+
+	st->tsense_bg |= tsense;
+	st->isense_bg |= isense;
+	fsleep(settle_us);
+
+	return 0;
+}
+
+/*
+ * Program the sequencer with @seq, indexed like ad7293_seq_regs. Registers
+ * already holding the requested channels are not written again, so that
+ * repeated reads of one channel go straight to the conversion command.
+ */
+static int __ad7293_seq_set(struct ad7293_state *st, const u16 *seq)
+{
+	struct ad7293_reg_write w[ARRAY_SIZE(ad7293_seq_regs)];
+	unsigned int i, n = 0;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(ad7293_seq_regs); i++) {
+		if (seq[i] != st->seq[i])
+			w[n++] = (struct ad7293_reg_write){ ad7293_seq_regs[i], seq[i] };
+	}
+
+	ret = __ad7293_spi_write_seq(st, w, n);
+	if (ret) {
+		/* Force a full rewrite next time */
+		memset(st->seq, 0xff, sizeof(st->seq));
+		return ret;
+	}
+
+	memcpy(st->seq, seq, sizeof(st->seq));
+
+	return 0;
+}
+
+static void ad7293_latest_update(struct ad7293_state *st, unsigned int index,
+				 u16 raw, s64 timestamp)
+{
+	unsigned long flags;
+
+	write_seqlock_irqsave(&st->latest_lock, flags);
+	st->latest_raw[index] = raw;
+	st->latest_ts[index] = timestamp;
+	st->latest_valid |= BIT(index);
+	write_sequnlock_irqrestore(&st->latest_lock, flags);
+}
+
+/*
+ * Run 2^osr conversions back to back in a single SPI message, each conversion
+ * command being followed by the sequencer latency and the readback of the
+ * result, and return their rounded average.
+ */
+static int __ad7293_read_oversampled(struct ad7293_state *st, unsigned int reg,
+				     unsigned int latency_us, unsigned int osr,
+				     u16 *raw)
+{
+	unsigned int i, num = BIT(osr);
+	struct spi_transfer *xfers;
+	u32 sum = 0;
+	u8 *buf;
+	int ret;
+
+	/* The conversion command is common to all pages */
+	ret = ad7293_page_select(st, reg);
+	if (ret)
+		return ret;
+
+	xfers = kcalloc(2 * num, sizeof(*xfers), GFP_KERNEL);
+	if (!xfers)
+		return -ENOMEM;
+
+	buf = kcalloc(num, 6, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto free_xfers;
+	}
+
+	for (i = 0; i < num; i++) {
+		u8 *cmd = &buf[6 * i], *res = &buf[6 * i + 3];
+
+		xfers[2 * i].tx_buf = cmd;
+		xfers[2 * i].len = ad7293_frame_write(cmd, AD7293_REG_CONV_CMD,
+						      AD7293_CONV_CMD_VAL);
+		xfers[2 * i].cs_change = 1;
+		xfers[2 * i].speed_hz = st->write_hz;
+		xfers[2 * i].cs_change_delay.value = latency_us;
+		xfers[2 * i].cs_change_delay.unit = SPI_DELAY_UNIT_USECS;
+
+		xfers[2 * i + 1].tx_buf = res;
+		xfers[2 * i + 1].rx_buf = res;
+		xfers[2 * i + 1].len = ad7293_frame_read(res, reg);
+		xfers[2 * i + 1].cs_change = 1;
+		xfers[2 * i + 1].speed_hz = st->read_hz;
+	}
+
+	xfers[2 * num - 1].cs_change = 0;
+
+	ret = spi_sync_transfer(st->spi, xfers, 2 * num);
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
+		goto free_buf;
+	}
+
+	for (i = 0; i < num; i++)
+		sum += FIELD_GET(AD7293_REG_DATA_RAW_MSK,
+				 ad7293_frame_val(&buf[6 * i + 3], reg));
+
+	*raw = (sum + num / 2) >> osr;
+
+free_buf:
+	kfree(buf);
+free_xfers:
+	kfree(xfers);
+
+	return ret;
+}
+
+static int ad7293_set_oversampling(struct ad7293_state *st,
+				   unsigned int index, int ratio)
+{
+	unsigned int max = oversampling_table[ARRAY_SIZE(oversampling_table) - 1];
+
+	if (ratio < 1 || ratio > max || !is_power_of_2(ratio))
+		return -EINVAL;
+
+	mutex_lock(&st->lock);
+	st->osr[index] = ilog2(ratio);
+	mutex_unlock(&st->lock);
+
+	return 0;
+}
+
+static int ad7293_ch_read_raw(struct ad7293_state *st, enum ad7293_ch_type type,
+			      unsigned int ch, u16 *raw)
+{
+	const struct ad7293_ch_desc *desc = NULL;
+	unsigned int index = 0, reg_rd, latency_us, osr = 0;
+	u16 seq[ARRAY_SIZE(ad7293_seq_regs)] = {};
+	s64 timestamp = 0;
+	int ret;
+
+	if (type == AD7293_DAC) {
+		reg_rd = ad7293_ch_result(ad7293_dac_desc(ch));
+	} else {
+		index = ad7293_ch_index(type, ch);
+		desc = &ad7293_ch_descs[index];
+		reg_rd = ad7293_ch_result(desc);
+		osr = st->osr[index];
+		seq[ad7293_seq_idx(desc)] = desc->seq_bit;
+	}
+
+	mutex_lock(&st->lock);
+
+	if (desc) {
+		ret = __ad7293_bg_enable(st, desc->tsense_bg, desc->isense_bg);
+		if (ret)
+			goto exit;
+
+		ret = __ad7293_seq_set(st, seq);
+		if (ret)
+			goto exit;
+	}
+
+	latency_us = ad7293_conv_latency_us(st, 1, desc ? desc->vin_bit : 0);
+
+	if (osr) {
+		/* Stamped at the first of the averaged conversions */
+		timestamp = ktime_get_ns();
+
+		ret = __ad7293_read_oversampled(st, reg_rd, latency_us, osr, raw);
+		if (ret)
+			goto exit;
+	} else {
+		if (desc) {
+			reinit_completion(&st->conv_done);
+
+			ret = __ad7293_spi_write(st, AD7293_REG_CONV_CMD,
+						 AD7293_CONV_CMD_VAL);
+			if (ret)
+				goto exit;
+
+			/* The conversion started when chip select was released */
+			timestamp = ktime_get_ns();
+
+			ret = __ad7293_wait_conversion(st, latency_us);
+			if (ret)
+				goto exit;
 		}
 
+		ret = __ad7293_spi_read(st, reg_rd, raw);
+		if (ret)
+			goto exit;
+
+		*raw = FIELD_GET(AD7293_REG_DATA_RAW_MSK, *raw);
+	}
+
+	if (desc)
+		ad7293_latest_update(st, index, *raw, timestamp);
+
+exit:
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+static int ad7293_chan_read_raw(struct ad7293_state *st,
+				struct iio_chan_spec const *chan, u16 *data)
+{
+	switch (chan->type) {
+	case IIO_VOLTAGE:
+		if (chan->output)
+			return ad7293_ch_read_raw(st, AD7293_DAC, chan->channel,
+						  data);
+
+		return ad7293_ch_read_raw(st, AD7293_ADC_VINX, chan->channel,
+					  data);
+	case IIO_CURRENT:
+		return ad7293_ch_read_raw(st, AD7293_ADC_ISENSE, chan->channel,
+					  data);
+	case IIO_TEMP:
+		return ad7293_ch_read_raw(st, AD7293_ADC_TSENSE, chan->channel,
+					  data);
+	default:
+		return -EINVAL;
+	}
+}
+
+static void ad7293_lat_record(struct ad7293_state *st, enum ad7293_lat_op op,
+			      ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	unsigned int i;
+
+	i = min_t(unsigned int, fls64(max_t(s64, us, 0)), AD7293_LAT_BUCKETS - 1);
+
+	spin_lock(&st->lat_lock);
+	st->lat_hist[op][i]++;
+	spin_unlock(&st->lat_lock);
+}
+
+static enum ad7293_lat_op ad7293_lat_read_op(struct iio_chan_spec const *chan)
+{
+	switch (chan->type) {
+	case IIO_CURRENT:
+		return AD7293_LAT_READ_ISENSE;
+	case IIO_TEMP:
+		return AD7293_LAT_READ_TSENSE;
+	default:
+		return chan->output ? AD7293_LAT_READ_DAC : AD7293_LAT_READ_VIN;
+	}
+}
+
+static int ad7293_pm_get(struct ad7293_state *st)
+{
+	return pm_runtime_resume_and_get(&st->spi->dev);
+}
+
+static void ad7293_pm_put(struct ad7293_state *st)
+{
+	pm_runtime_mark_last_busy(&st->spi->dev);
+	pm_runtime_put_autosuspend(&st->spi->dev);
+}
+
+static int __ad7293_read_raw(struct iio_dev *indio_dev,
+			     struct iio_chan_spec const *chan,
+			     int *val, int *val2, long info)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	int ret;
+	u16 data;
+
+	switch (info) {
+	case IIO_CHAN_INFO_RAW:
+		/* Direct reads reprogram the sequencer used by buffered scans */
+		ret = iio_device_claim_direct_mode(indio_dev);
+		if (ret)
+			return ret;
+
+		ret = ad7293_chan_read_raw(st, chan, &data);
+		iio_device_release_direct_mode(indio_dev);
 		if (ret)
 			return ret;
 
@@ -514,76 +1399,122 @@ static int ad7293_read_raw(struct iio_dev *indio_dev,
 
 		return IIO_VAL_INT;
 	case IIO_CHAN_INFO_OFFSET:
-		switch (chan->type) {
-		case IIO_VOLTAGE:
-			if (chan->output) {
-				ret = ad7293_get_offset(st,
-							chan->channel + AD7293_VOUT_MIN_OFFSET_CH,
-							&data);
-
-				data = FIELD_GET(AD7293_REG_VOUT_OFFSET_MSK, data);
-			} else {
-				ret = ad7293_get_offset(st, chan->channel, &data);
-			}
-
-			break;
-		case IIO_CURRENT:
-			ret = ad7293_get_offset(st,
-						chan->channel + AD7293_ISENSE_MIN_OFFSET_CH,
-						&data);
-
-			break;
-		case IIO_TEMP:
-			ret = ad7293_get_offset(st,
-						chan->channel + AD7293_TSENSE_MIN_OFFSET_CH,
-						&data);
+		if (!chan->output) {
+			/* Differential VINx inputs are coded in offset binary */
+			*val = st->vin_diff & BIT(chan->channel) ?
+			       -(int)BIT(AD7293_ADC_RESOLUTION - 1) : 0;
 
-			break;
-		default:
-			return -EINVAL;
+			return IIO_VAL_INT;
 		}
+
+		ret = ad7293_get_offset(st, chan, &data);
 		if (ret)
 			return ret;
 
 		*val = data;
 
+		return IIO_VAL_INT;
+	case IIO_CHAN_INFO_CALIBBIAS:
+		ret = ad7293_get_offset(st, chan, &data);
+		if (ret)
+			return ret;
+
+		/* The trim is a two's complement correction of the code */
+		*val = (s8)data;
+
 		return IIO_VAL_INT;
 	case IIO_CHAN_INFO_SCALE:
 		switch (chan->type) {
 		case IIO_VOLTAGE:
-			ret = ad7293_adc_get_scale(st, chan->channel, &data);
-			if (ret)
-				return ret;
-
-			*val = data;
+			data = st->vin_range[chan->channel];
+			*val = st->vin_scale[data][0];
+			*val2 = st->vin_scale[data][1];
 
-			return IIO_VAL_INT;
+			return IIO_VAL_INT_PLUS_NANO;
 		case IIO_CURRENT:
-			ret = ad7293_isense_get_scale(st, chan->channel, &data);
-			if (ret)
-				return ret;
-
-			*val = data;
+			data = st->isense_gain[chan->channel];
+			*val = st->isense_scale[chan->channel][data][0];
+			*val2 = st->isense_scale[chan->channel][data][1];
 
-			return IIO_VAL_INT;
+			return IIO_VAL_INT_PLUS_NANO;
 		case IIO_TEMP:
-			*val = 1;
-			*val2 = 8;
+			*val = AD7293_TSENSE_SCALE_MILLI_C;
 
-			return IIO_VAL_FRACTIONAL;
+			return IIO_VAL_INT;
 		default:
 			return -EINVAL;
 		}
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		*val = BIT(st->osr[chan->scan_index]);
+
+		return IIO_VAL_INT;
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		*val = st->offload_trigger_hz;
+
+		return IIO_VAL_INT;
 	default:
 		return -EINVAL;
 	}
 }
 
-static int ad7293_write_raw(struct iio_dev *indio_dev,
-			    struct iio_chan_spec const *chan,
-			    int val, int val2, long info)
+static int ad7293_read_raw(struct iio_dev *indio_dev,
+			   struct iio_chan_spec const *chan,
+			   int *val, int *val2, long info)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	ktime_t start = ktime_get();
+	int ret;
+
+	/* These are served from the cache and do not need the device awake */
+	if ((info == IIO_CHAN_INFO_OFFSET && !chan->output) ||
+	    info == IIO_CHAN_INFO_SCALE ||
+	    info == IIO_CHAN_INFO_OVERSAMPLING_RATIO ||
+	    info == IIO_CHAN_INFO_SAMP_FREQ)
+		return __ad7293_read_raw(indio_dev, chan, val, val2, info);
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	ret = __ad7293_read_raw(indio_dev, chan, val, val2, info);
+	ad7293_pm_put(st);
+
+	/*
+	 * Includes waking the device up, as seen by the caller. Offset reads
+	 * are register reads and would skew the conversion histograms.
+	 */
+	if (info == IIO_CHAN_INFO_RAW)
+		ad7293_lat_record(st, ad7293_lat_read_op(chan), start);
+
+	return ret;
+}
+
+static int ad7293_set_sample_freq(struct ad7293_state *st, u64 freq_hz)
+{
+	struct spi_offload_trigger_config config = {
+		.type = SPI_OFFLOAD_TRIGGER_PERIODIC,
+		.periodic = {
+			.frequency_hz = freq_hz,
+		},
+	};
+	int ret;
+
+	/* The trigger rounds the rate to what it can generate */
+	ret = spi_offload_trigger_validate(st->offload_trigger, &config);
+	if (ret)
+		return ret;
+
+	st->offload_trigger_hz = config.periodic.frequency_hz;
+
+	return 0;
+}
+
+static int __ad7293_write_raw(struct iio_dev *indio_dev,
+			      struct iio_chan_spec const *chan,
+			      int val, int val2, long info)
 {
 	struct ad7293_state *st = iio_priv(indio_dev);
+	int ret;
 
 	switch (info) {
 	case IIO_CHAN_INFO_RAW:
@@ -597,317 +1528,2601 @@ static int ad7293_write_raw(struct iio_dev *indio_dev,
 			return -EINVAL;
 		}
 	case IIO_CHAN_INFO_OFFSET:
-		switch (chan->type) {
-		case IIO_VOLTAGE:
-			if (chan->output)
-				return ad7293_set_offset(st,
-							 chan->channel +
-							 AD7293_VOUT_MIN_OFFSET_CH,
-							 val);
-			else
-				return ad7293_set_offset(st, chan->channel, val);
-		case IIO_CURRENT:
-			return ad7293_set_offset(st,
-						 chan->channel +
-						 AD7293_ISENSE_MIN_OFFSET_CH,
-						 val);
-		case IIO_TEMP:
-			return ad7293_set_offset(st,
-						 chan->channel +
-						 AD7293_TSENSE_MIN_OFFSET_CH,
-						 val);
-		default:
+		/* ADC offsets follow from the input mode */
+		if (!chan->output)
 			return -EINVAL;
-		}
+
+		return ad7293_set_offset(st, chan, val);
+	case IIO_CHAN_INFO_CALIBBIAS:
+		if (val < S8_MIN || val > S8_MAX)
+			return -EINVAL;
+
+		return ad7293_set_offset(st, chan, (u8)val);
 	case IIO_CHAN_INFO_SCALE:
 		switch (chan->type) {
 		case IIO_VOLTAGE:
-			return ad7293_adc_set_scale(st, chan->channel, val);
+			ret = ad7293_find_scale(st->vin_scale,
+						ARRAY_SIZE(st->vin_scale),
+						val, val2);
+			if (ret < 0)
+				return ret;
+
+			return ad7293_adc_set_scale(st, chan->channel, ret);
 		case IIO_CURRENT:
-			return ad7293_isense_set_scale(st, chan->channel, val);
+			ret = ad7293_find_scale(st->isense_scale[chan->channel],
+						ARRAY_SIZE(st->isense_scale[0]),
+						val, val2);
+			if (ret < 0)
+				return ret;
+
+			return ad7293_isense_set_scale(st, chan->channel, ret);
 		default:
 			return -EINVAL;
 		}
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		return ad7293_set_oversampling(st, chan->scan_index, val);
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		if (!st->offload || val <= 0)
+			return -EINVAL;
+
+		/* The rate is handed to the trigger when a capture starts */
+		ret = iio_device_claim_direct_mode(indio_dev);
+		if (ret)
+			return ret;
+
+		ret = ad7293_set_sample_freq(st, val);
+		iio_device_release_direct_mode(indio_dev);
+
+		return ret;
 	default:
 		return -EINVAL;
 	}
 }
 
-static int ad7293_reg_access(struct iio_dev *indio_dev,
-			     unsigned int reg,
-			     unsigned int write_val,
-			     unsigned int *read_val)
+static int ad7293_write_raw(struct iio_dev *indio_dev,
+			    struct iio_chan_spec const *chan,
+			    int val, int val2, long info)
 {
 	struct ad7293_state *st = iio_priv(indio_dev);
+	ktime_t start = ktime_get();
 	int ret;
 
-	if (read_val) {
-		u16 temp;
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
 
-		ret = ad7293_spi_read(st, reg, &temp);
-		*read_val = temp;
-	} else {
-		ret = ad7293_spi_write(st, reg, (u16)write_val);
-	}
+	ret = __ad7293_write_raw(indio_dev, chan, val, val2, info);
+	ad7293_pm_put(st);
+
+	ad7293_lat_record(st, info == IIO_CHAN_INFO_RAW ? AD7293_LAT_WRITE_DAC :
+			  AD7293_LAT_CONFIG, start);
 
 	return ret;
 }
 
-static int ad7293_read_avail(struct iio_dev *indio_dev,
-			     struct iio_chan_spec const *chan,
-			     const int **vals, int *type, int *length,
-			     long info)
+static int ad7293_write_raw_get_fmt(struct iio_dev *indio_dev,
+				    struct iio_chan_spec const *chan, long info)
 {
 	switch (info) {
-	case IIO_CHAN_INFO_OFFSET:
-		*vals = dac_offset_table;
-		*type = IIO_VAL_INT;
-		*length = ARRAY_SIZE(dac_offset_table);
-
-		return IIO_AVAIL_LIST;
 	case IIO_CHAN_INFO_SCALE:
-		*type = IIO_VAL_INT;
+		return IIO_VAL_INT_PLUS_NANO;
+	default:
+		return IIO_VAL_INT_PLUS_MICRO;
+	}
+}
 
-		switch (chan->type) {
-		case IIO_VOLTAGE:
-			*vals = adc_range_table;
-			*length = ARRAY_SIZE(adc_range_table);
-			return IIO_AVAIL_LIST;
-		case IIO_CURRENT:
-			*vals = isense_gain_table;
-			*length = ARRAY_SIZE(isense_gain_table);
+/* Whether a raw register number from debugfs addresses the register @ref */
+static bool ad7293_reg_match(unsigned int reg, unsigned int ref)
+{
+	unsigned int addr = FIELD_GET(AD7293_REG_ADDR_MSK, reg);
+
+	if (addr != FIELD_GET(AD7293_REG_ADDR_MSK, ref))
+		return false;
+
+	if (addr < AD7293_NUM_COMMON_REGS)
+		return true;
+
+	return ad7293_reg_page(reg) == ad7293_reg_page(ref);
+}
+
+/* Return the cached device state to its power-on value */
+static void __ad7293_cache_reset(struct ad7293_state *st)
+{
+	st->page_select = AD7293_PAGE_INVALID;
+	memset(st->seq, 0, sizeof(st->seq));
+	st->dac_en = 0;
+	st->gpio_out = 0;
+	st->gpio_out_en = 0;
+	st->gpio_func = 0;
+	st->tsense_bg = 0;
+	st->isense_bg = 0;
+	st->conv_delay = 0;
+	st->vin_filter = 0;
+	st->vin_diff = 0;
+	memset(st->vin_range, 0, sizeof(st->vin_range));
+	memset(st->isense_gain, 0, sizeof(st->isense_gain));
+}
+
+/*
+ * Bring the caches in line with a raw register write made through debugfs,
+ * so that later accesses do not skip programming the device needs.
+ */
+static void __ad7293_cache_sync(struct ad7293_state *st, unsigned int reg,
+				u16 val)
+{
+	unsigned int i, gain;
+
+	if (ad7293_reg_match(reg, AD7293_REG_SOFT_RESET)) {
+		__ad7293_cache_reset(st);
+	} else if (ad7293_reg_match(reg, AD7293_REG_PAGE_SELECT)) {
+		st->page_select = AD7293_PAGE_INVALID;
+	} else if (ad7293_reg_match(reg, AD7293_REG_DAC_EN)) {
+		st->dac_en = val;
+	} else if (ad7293_reg_match(reg, AD7293_REG_DIGITAL_INOUT)) {
+		st->gpio_out = val & GENMASK(AD7293_NUM_GPIO - 1, 0);
+	} else if (ad7293_reg_match(reg, AD7293_REG_DIGITAL_OUT_EN)) {
+		st->gpio_out_en = val & GENMASK(AD7293_NUM_GPIO - 1, 0);
+	} else if (ad7293_reg_match(reg, AD7293_REG_DIGITAL_INOUT_FUNC)) {
+		st->gpio_func = val & GENMASK(AD7293_NUM_GPIO - 1, 0);
+	} else if (ad7293_reg_match(reg, AD7293_REG_VINX_RANGE0)) {
+		for (i = 0; i < AD7293_NUM_VINX; i++)
+			st->vin_range[i] = (st->vin_range[i] & 0x1) |
+				AD7293_REG_VINX_RANGE_GET_CH_MSK(val, i) << 1;
+	} else if (ad7293_reg_match(reg, AD7293_REG_VINX_RANGE1)) {
+		for (i = 0; i < AD7293_NUM_VINX; i++)
+			st->vin_range[i] = (st->vin_range[i] & 0x2) |
+				AD7293_REG_VINX_RANGE_GET_CH_MSK(val, i);
+	} else if (ad7293_reg_match(reg, AD7293_REG_VINX_DIFF_SE)) {
+		st->vin_diff = val & GENMASK(AD7293_NUM_VINX - 1, 0);
+	} else if (ad7293_reg_match(reg, AD7293_REG_VINX_FILTER)) {
+		st->vin_filter = val & GENMASK(AD7293_NUM_VINX - 1, 0);
+	} else if (ad7293_reg_match(reg, AD7293_REG_CONV_DELAY)) {
+		st->conv_delay = FIELD_GET(AD7293_REG_CONV_DELAY_MSK, val);
+	} else if (ad7293_reg_match(reg, AD7293_REG_TSENSE_BG_EN)) {
+		/* A bandgap turned back on still has to settle */
+		st->tsense_bg &= val;
+	} else if (ad7293_reg_match(reg, AD7293_REG_ISENSE_BG_EN)) {
+		st->isense_bg &= val;
+	} else if (ad7293_reg_match(reg, AD7293_REG_ISENSE_GAIN)) {
+		for (i = 0; i < AD7293_NUM_ISENSE; i++) {
+			gain = (val & AD7293_REG_ISENSE_GAIN_MSK(i)) >> (4 * i);
+			/* Codes past the table are reserved, keep scales valid */
+			st->isense_gain[i] = min_t(unsigned int, gain,
+						   ARRAY_SIZE(isense_gain_table) - 1);
+		}
+	} else {
+		for (i = 0; i < ARRAY_SIZE(ad7293_seq_regs); i++) {
+			if (ad7293_reg_match(reg, ad7293_seq_regs[i]))
+				st->seq[i] = val;
+		}
+	}
+}
+
+static int ad7293_reg_access(struct iio_dev *indio_dev,
+			     unsigned int reg,
+			     unsigned int write_val,
+			     unsigned int *read_val)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	int ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	if (read_val) {
+		u16 temp;
+
+		ret = ad7293_spi_read(st, reg, &temp);
+		*read_val = temp;
+	} else {
+		mutex_lock(&st->lock);
+		ret = __ad7293_spi_write(st, reg, (u16)write_val);
+		if (!ret)
+			__ad7293_cache_sync(st, reg, write_val);
+		mutex_unlock(&st->lock);
+	}
+
+	ad7293_pm_put(st);
+
+	return ret;
+}
+
+static int ad7293_read_avail(struct iio_dev *indio_dev,
+			     struct iio_chan_spec const *chan,
+			     const int **vals, int *type, int *length,
+			     long info)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	switch (info) {
+	case IIO_CHAN_INFO_OFFSET:
+		*vals = dac_offset_table;
+		*type = IIO_VAL_INT;
+		*length = ARRAY_SIZE(dac_offset_table);
+
+		return IIO_AVAIL_LIST;
+	case IIO_CHAN_INFO_SCALE:
+		*type = IIO_VAL_INT_PLUS_NANO;
+
+		switch (chan->type) {
+		case IIO_VOLTAGE:
+			*vals = (const int *)st->vin_scale;
+			*length = 2 * ARRAY_SIZE(st->vin_scale);
+			return IIO_AVAIL_LIST;
+		case IIO_CURRENT:
+			*vals = (const int *)st->isense_scale[chan->channel];
+			*length = 2 * ARRAY_SIZE(st->isense_scale[0]);
 			return IIO_AVAIL_LIST;
 		default:
 			return -EINVAL;
 		}
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		*vals = oversampling_table;
+		*type = IIO_VAL_INT;
+		*length = ARRAY_SIZE(oversampling_table);
+
+		return IIO_AVAIL_LIST;
 	default:
 		return -EINVAL;
 	}
-}
+}
+
+static ssize_t ad7293_read_filter(struct iio_dev *indio_dev, uintptr_t private,
+				  const struct iio_chan_spec *chan, char *buf)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	return sysfs_emit(buf, "%u\n", !!(st->vin_filter & BIT(chan->channel)));
+}
+
+static ssize_t ad7293_write_filter(struct iio_dev *indio_dev, uintptr_t private,
+				   const struct iio_chan_spec *chan,
+				   const char *buf, size_t len)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	bool enable;
+	int ret;
+
+	ktime_t start = ktime_get();
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	ret = ad7293_vin_set_filter(st, chan->channel, enable);
+	ad7293_pm_put(st);
+	ad7293_lat_record(st, AD7293_LAT_CONFIG, start);
+
+	return ret ? ret : len;
+}
+
+static ssize_t ad7293_read_conv_delay(struct iio_dev *indio_dev,
+				      uintptr_t private,
+				      const struct iio_chan_spec *chan,
+				      char *buf)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	return sysfs_emit(buf, "%d\n", conv_delay_table[st->conv_delay]);
+}
+
+static ssize_t ad7293_write_conv_delay(struct iio_dev *indio_dev,
+				       uintptr_t private,
+				       const struct iio_chan_spec *chan,
+				       const char *buf, size_t len)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	unsigned int delay;
+	int ret;
+
+	ktime_t start = ktime_get();
+
+	ret = kstrtouint(buf, 10, &delay);
+	if (ret)
+		return ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	ret = ad7293_set_conv_delay(st, delay);
+	ad7293_pm_put(st);
+	ad7293_lat_record(st, AD7293_LAT_CONFIG, start);
+
+	return ret ? ret : len;
+}
+
+static ssize_t ad7293_read_conv_delay_avail(struct iio_dev *indio_dev,
+					    uintptr_t private,
+					    const struct iio_chan_spec *chan,
+					    char *buf)
+{
+	unsigned int i;
+	int len = 0;
+
+	for (i = 0; i < ARRAY_SIZE(conv_delay_table); i++)
+		len += sysfs_emit_at(buf, len, "%d ", conv_delay_table[i]);
+
+	buf[len - 1] = '\n';
+
+	return len;
+}
+
+static const char * const ad7293_input_modes[] = {
+	"single-ended",
+	"differential",
+};
+
+static int ad7293_get_input_mode(struct iio_dev *indio_dev,
+				 const struct iio_chan_spec *chan)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	return !!(st->vin_diff & BIT(chan->channel));
+}
+
+static int ad7293_set_input_mode(struct iio_dev *indio_dev,
+				 const struct iio_chan_spec *chan,
+				 unsigned int mode)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	ret = ad7293_vin_set_diff(st, chan->channel, mode);
+	ad7293_pm_put(st);
+	ad7293_lat_record(st, AD7293_LAT_CONFIG, start);
+
+	return ret;
+}
+
+static const struct iio_enum ad7293_input_mode_enum = {
+	.items = ad7293_input_modes,
+	.num_items = ARRAY_SIZE(ad7293_input_modes),
+	.get = ad7293_get_input_mode,
+	.set = ad7293_set_input_mode,
+};
+
+static ssize_t ad7293_read_scan_div(struct iio_dev *indio_dev,
+				    uintptr_t private,
+				    const struct iio_chan_spec *chan, char *buf)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	return sysfs_emit(buf, "%u\n", st->scan_div[chan->scan_index]);
+}
+
+static ssize_t ad7293_write_scan_div(struct iio_dev *indio_dev,
+				     uintptr_t private,
+				     const struct iio_chan_spec *chan,
+				     const char *buf, size_t len)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	unsigned int div;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &div);
+	if (ret)
+		return ret;
+
+	if (!div || div > U16_MAX)
+		return -EINVAL;
+
+	/* The schedule is laid out when a capture starts */
+	ret = iio_device_claim_direct_mode(indio_dev);
+	if (ret)
+		return ret;
+
+	st->scan_div[chan->scan_index] = div;
+	iio_device_release_direct_mode(indio_dev);
+
+	return len;
+}
+
+/* Triggers between two conversions of a channel in a buffered capture */
+#define AD7293_SCAN_DIV_EXT_INFO {					\
+	.name = "scan_divider",						\
+	.shared = IIO_SEPARATE,						\
+	.read = ad7293_read_scan_div,					\
+	.write = ad7293_write_scan_div,					\
+}
+
+static const struct iio_chan_spec_ext_info ad7293_adc_ext_info[] = {
+	AD7293_SCAN_DIV_EXT_INFO,
+	{ }
+};
+
+static const struct iio_chan_spec_ext_info ad7293_vin_ext_info[] = {
+	{
+		.name = "filter_enable",
+		.shared = IIO_SEPARATE,
+		.read = ad7293_read_filter,
+		.write = ad7293_write_filter,
+	},
+	{
+		.name = "conversion_delay_us",
+		.shared = IIO_SHARED_BY_ALL,
+		.read = ad7293_read_conv_delay,
+		.write = ad7293_write_conv_delay,
+	},
+	{
+		.name = "conversion_delay_us_available",
+		.shared = IIO_SHARED_BY_ALL,
+		.read = ad7293_read_conv_delay_avail,
+	},
+	IIO_ENUM("input_mode", IIO_SEPARATE, &ad7293_input_mode_enum),
+	IIO_ENUM_AVAILABLE("input_mode", IIO_SHARED_BY_TYPE,
+			   &ad7293_input_mode_enum),
+	AD7293_SCAN_DIV_EXT_INFO,
+	{ }
+};
+
+static const struct iio_event_spec ad7293_events[] = {
+	{
+		.type = IIO_EV_TYPE_THRESH,
+		.dir = IIO_EV_DIR_RISING,
+		.mask_separate = BIT(IIO_EV_INFO_VALUE) |
+				 BIT(IIO_EV_INFO_ENABLE),
+	}, {
+		.type = IIO_EV_TYPE_THRESH,
+		.dir = IIO_EV_DIR_FALLING,
+		.mask_separate = BIT(IIO_EV_INFO_VALUE) |
+				 BIT(IIO_EV_INFO_ENABLE),
+	}, {
+		.type = IIO_EV_TYPE_ROC,
+		.dir = IIO_EV_DIR_RISING,
+		.mask_separate = BIT(IIO_EV_INFO_VALUE) |
+				 BIT(IIO_EV_INFO_ENABLE),
+	}, {
+		.type = IIO_EV_TYPE_ROC,
+		.dir = IIO_EV_DIR_FALLING,
+		.mask_separate = BIT(IIO_EV_INFO_VALUE) |
+				 BIT(IIO_EV_INFO_ENABLE),
+	},
+};
+
+#define AD7293_SCAN_TYPE {						\
+	.sign = 'u',							\
+	.realbits = 12,							\
+	.storagebits = 16,						\
+	.shift = 4,							\
+	.endianness = IIO_BE,						\
+}
+
+/* Results as the offload stream stores them, one 32-bit word each */
+static const struct iio_scan_type ad7293_offload_scan_type = {
+	.sign = 'u',
+	.realbits = 12,
+	.storagebits = 32,
+	.shift = 4,
+	.endianness = IIO_CPU,
+};
+
+#define AD7293_CHAN_ADC(_channel, _si) {				\
+	.type = IIO_VOLTAGE,						\
+	.output = 0,							\
+	.indexed = 1,							\
+	.channel = _channel,						\
+	.address = AD7293_REG_VIN0 + (_channel),			\
+	.datasheet_name = "VIN" #_channel,				\
+	.scan_index = _si,						\
+	.scan_type = AD7293_SCAN_TYPE,					\
+	.event_spec = ad7293_events,					\
+	.num_event_specs = ARRAY_SIZE(ad7293_events),			\
+	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
+			      BIT(IIO_CHAN_INFO_SCALE) |		\
+			      BIT(IIO_CHAN_INFO_OFFSET) |		\
+			      BIT(IIO_CHAN_INFO_CALIBBIAS) |		\
+			      BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO),	\
+	.info_mask_separate_available =					\
+		BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO),			\
+	.info_mask_shared_by_type_available = BIT(IIO_CHAN_INFO_SCALE),	\
+	.ext_info = ad7293_vin_ext_info,				\
+}
+
+#define AD7293_CHAN_DAC(_channel, _name) {				\
+	.type = IIO_VOLTAGE,						\
+	.output = 1,							\
+	.indexed = 1,							\
+	.channel = _channel,						\
+	.datasheet_name = _name,					\
+	.scan_index = -1,						\
+	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
+			      BIT(IIO_CHAN_INFO_OFFSET),		\
+	.info_mask_shared_by_type_available = BIT(IIO_CHAN_INFO_OFFSET)	\
+}
+
+#define AD7293_CHAN_ISENSE(_channel, _si) {				\
+	.type = IIO_CURRENT,						\
+	.output = 0,							\
+	.indexed = 1,							\
+	.channel = _channel,						\
+	.address = AD7293_REG_ISENSE_0 + (_channel),			\
+	.datasheet_name = "ISENSE" #_channel,				\
+	.scan_index = _si,						\
+	.scan_type = AD7293_SCAN_TYPE,					\
+	.event_spec = ad7293_events,					\
+	.num_event_specs = ARRAY_SIZE(ad7293_events),			\
+	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
+			      BIT(IIO_CHAN_INFO_CALIBBIAS) |		\
+			      BIT(IIO_CHAN_INFO_SCALE) |		\
+			      BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO),	\
+	.info_mask_separate_available = BIT(IIO_CHAN_INFO_SCALE) |	\
+		BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO),			\
+	.ext_info = ad7293_adc_ext_info,				\
+}
+
+#define AD7293_CHAN_TEMP(_channel, _si, _name) {			\
+	.type = IIO_TEMP,						\
+	.output = 0,							\
+	.indexed = 1,							\
+	.channel = _channel,						\
+	.address = AD7293_REG_TSENSE_INT + (_channel),			\
+	.datasheet_name = _name,					\
+	.scan_index = _si,						\
+	.scan_type = AD7293_SCAN_TYPE,					\
+	.event_spec = ad7293_events,					\
+	.num_event_specs = ARRAY_SIZE(ad7293_events),			\
+	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
+			      BIT(IIO_CHAN_INFO_CALIBBIAS),		\
+	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),		\
+	.ext_info = ad7293_adc_ext_info,				\
+}
+
+static const struct iio_chan_spec ad7293_channels[] = {
+	AD7293_CHAN_ADC(0, 0),
+	AD7293_CHAN_ADC(1, 1),
+	AD7293_CHAN_ADC(2, 2),
+	AD7293_CHAN_ADC(3, 3),
+	AD7293_CHAN_ISENSE(0, 4),
+	AD7293_CHAN_ISENSE(1, 5),
+	AD7293_CHAN_ISENSE(2, 6),
+	AD7293_CHAN_ISENSE(3, 7),
+	AD7293_CHAN_TEMP(0, 8, "TSENSE_INT"),
+	AD7293_CHAN_TEMP(1, 9, "TSENSE_D0"),
+	AD7293_CHAN_TEMP(2, 10, "TSENSE_D1"),
+	AD7293_CHAN_DAC(0, "UNI_VOUT0"),
+	AD7293_CHAN_DAC(1, "UNI_VOUT1"),
+	AD7293_CHAN_DAC(2, "UNI_VOUT2"),
+	AD7293_CHAN_DAC(3, "UNI_VOUT3"),
+	AD7293_CHAN_DAC(4, "BI_VOUT0"),
+	AD7293_CHAN_DAC(5, "BI_VOUT1"),
+	AD7293_CHAN_DAC(6, "BI_VOUT2"),
+	AD7293_CHAN_DAC(7, "BI_VOUT3"),
+	IIO_CHAN_SOFT_TIMESTAMP(AD7293_NUM_ADC_CH),
+};
+
+/*
+ * Temperatures and drain currents handed to iio-hwmon on board file systems.
+ * Firmware described systems bind their consumers through io-channels.
+ */
+static const struct iio_map ad7293_default_maps[] = {
+	{ .adc_channel_label = "TSENSE_INT", .consumer_dev_name = "iio_hwmon" },
+	{ .adc_channel_label = "TSENSE_D0", .consumer_dev_name = "iio_hwmon" },
+	{ .adc_channel_label = "TSENSE_D1", .consumer_dev_name = "iio_hwmon" },
+	{ .adc_channel_label = "ISENSE0", .consumer_dev_name = "iio_hwmon" },
+	{ .adc_channel_label = "ISENSE1", .consumer_dev_name = "iio_hwmon" },
+	{ .adc_channel_label = "ISENSE2", .consumer_dev_name = "iio_hwmon" },
+	{ .adc_channel_label = "ISENSE3", .consumer_dev_name = "iio_hwmon" },
+	{ }
+};
+
+/*
+ * Build the scan of the channels in @mask as a single SPI message: the
+ * conversion command is followed by the time the sequencer needs for them,
+ * then every result register is read in its own chip select frame. @seq is
+ * filled with the matching sequencer content. @mask must hold an ADC channel.
+ */
+static int ad7293_scan_build(struct ad7293_state *st, unsigned long mask,
+			     u16 *seq)
+{
+	struct spi_transfer *xfer = &st->scan_xfers[1];
+	unsigned int bit, n = 0;
+	u16 vin = 0;
+
+	memset(st->scan_xfers, 0, sizeof(st->scan_xfers));
+	memset(seq, 0, sizeof(st->seq));
+
+	for_each_set_bit(bit, &mask, AD7293_NUM_ADC_CH) {
+		const struct ad7293_ch_desc *desc = &ad7293_ch_descs[bit];
+
+		seq[ad7293_seq_idx(desc)] |= desc->seq_bit;
+		vin |= desc->vin_bit;
+
+		xfer[n].tx_buf = st->scan_tx[n];
+		xfer[n].rx_buf = st->scan_rx[n];
+		xfer[n].len = ad7293_frame_read(st->scan_tx[n],
+						ad7293_ch_result(desc));
+		xfer[n].cs_change = 1;
+		xfer[n].speed_hz = st->read_hz;
+		n++;
+	}
+
+	if (!n)
+		return -EINVAL;
+
+	xfer[n - 1].cs_change = 0;
+
+	/* The conversion starts when chip select is deasserted */
+	st->scan_xfers[0].tx_buf = st->scan_cmd;
+	st->scan_xfers[0].len = ad7293_frame_write(st->scan_cmd,
+						   AD7293_REG_CONV_CMD,
+						   AD7293_CONV_CMD_VAL);
+	st->scan_xfers[0].cs_change = 1;
+	st->scan_xfers[0].speed_hz = st->write_hz;
+	st->scan_xfers[0].cs_change_delay.value =
+		ad7293_conv_latency_us(st, n, vin);
+	st->scan_xfers[0].cs_change_delay.unit = SPI_DELAY_UNIT_USECS;
+	/* Stamp the scan once the last byte of the command is out */
+	st->scan_xfers[0].ptp_sts = &st->scan_sts;
+	st->scan_xfers[0].ptp_sts_word_pre = 0;
+	st->scan_xfers[0].ptp_sts_word_post = 2;
+
+	spi_message_init_with_transfers(&st->scan_msg, st->scan_xfers, n + 1);
+	st->scan_num = n;
+
+	return 0;
+}
+
+static int ad7293_update_scan_mode(struct iio_dev *indio_dev,
+				   const unsigned long *scan_mask)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	u16 seq[ARRAY_SIZE(ad7293_seq_regs)];
+	u16 tsense_bg = 0, isense_bg = 0;
+	unsigned int bit;
+	int ret;
+
+	mutex_lock(&st->lock);
+
+	/* The first scan of a capture converts every channel */
+	ret = ad7293_scan_build(st, *scan_mask, seq);
+	if (ret)
+		goto out;
+
+	for_each_set_bit(bit, scan_mask, AD7293_NUM_ADC_CH) {
+		tsense_bg |= ad7293_ch_descs[bit].tsense_bg;
+		isense_bg |= ad7293_ch_descs[bit].isense_bg;
+	}
+
+	for (bit = 0; bit < AD7293_NUM_ADC_CH; bit++) {
+		st->scan_left[bit] = 0;
+		/* Rates of change are only measured between scans of one capture */
+		st->watch[bit].primed = false;
+	}
+
+	ret = __ad7293_seq_set(st, seq);
+	if (ret) {
+		st->scan_mask = 0;
+		goto out;
+	}
+
+	st->scan_mask = *scan_mask;
+
+	/*
+	 * Let the sensor bandgaps settle once instead of on every scan, so
+	 * that slow channels only cost their conversion when they are due.
+	 */
+	ret = __ad7293_bg_enable(st, tsense_bg, isense_bg);
+out:
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+static unsigned int ad7293_watch_idx(enum iio_event_type type,
+				     enum iio_event_direction dir)
+{
+	return (type == IIO_EV_TYPE_ROC) * 2 + (dir == IIO_EV_DIR_FALLING);
+}
+
+static int ad7293_read_event_config(struct iio_dev *indio_dev,
+				    const struct iio_chan_spec *chan,
+				    enum iio_event_type type,
+				    enum iio_event_direction dir)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	return !!(st->watch[chan->scan_index].enabled &
+		  BIT(ad7293_watch_idx(type, dir)));
+}
+
+static int ad7293_write_event_config(struct iio_dev *indio_dev,
+				     const struct iio_chan_spec *chan,
+				     enum iio_event_type type,
+				     enum iio_event_direction dir, bool state)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	struct ad7293_watch *watch = &st->watch[chan->scan_index];
+	unsigned int idx = ad7293_watch_idx(type, dir);
+
+	mutex_lock(&st->lock);
+
+	if (state)
+		watch->enabled |= BIT(idx);
+	else
+		watch->enabled &= ~BIT(idx);
+
+	watch->asserted &= ~BIT(idx);
+
+	mutex_unlock(&st->lock);
+
+	return 0;
+}
+
+static int ad7293_read_event_value(struct iio_dev *indio_dev,
+				   const struct iio_chan_spec *chan,
+				   enum iio_event_type type,
+				   enum iio_event_direction dir,
+				   enum iio_event_info info, int *val, int *val2)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	if (info != IIO_EV_INFO_VALUE)
+		return -EINVAL;
+
+	*val = st->watch[chan->scan_index].value[ad7293_watch_idx(type, dir)];
+
+	return IIO_VAL_INT;
+}
+
+static int ad7293_write_event_value(struct iio_dev *indio_dev,
+				    const struct iio_chan_spec *chan,
+				    enum iio_event_type type,
+				    enum iio_event_direction dir,
+				    enum iio_event_info info, int val, int val2)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	if (info != IIO_EV_INFO_VALUE || val < 0)
+		return -EINVAL;
+
+	if (type == IIO_EV_TYPE_THRESH && val > AD7293_ADC_MAX_CODE)
+		return -EINVAL;
+
+	mutex_lock(&st->lock);
+	st->watch[chan->scan_index].value[ad7293_watch_idx(type, dir)] = val;
+	mutex_unlock(&st->lock);
+
+	return 0;
+}
+
+/* A channel is found by scan index, not by its position in the array */
+static const struct iio_chan_spec *ad7293_scan_chan(struct iio_dev *indio_dev,
+						    unsigned int scan_index)
+{
+	unsigned int i;
+
+	for (i = 0; i < indio_dev->num_channels; i++)
+		if (indio_dev->channels[i].scan_index == scan_index)
+			return &indio_dev->channels[i];
+
+	return NULL;
+}
+
+/* Check one result of a scan against the watchdog of its channel */
+static void __ad7293_watch_eval(struct iio_dev *indio_dev,
+				const struct iio_chan_spec *chan, u16 raw,
+				s64 timestamp)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	struct ad7293_watch *watch = &st->watch[chan->scan_index];
+	static const struct {
+		enum iio_event_type type;
+		enum iio_event_direction dir;
+	} ev[] = {
+		{ IIO_EV_TYPE_THRESH, IIO_EV_DIR_RISING },
+		{ IIO_EV_TYPE_THRESH, IIO_EV_DIR_FALLING },
+		{ IIO_EV_TYPE_ROC, IIO_EV_DIR_RISING },
+		{ IIO_EV_TYPE_ROC, IIO_EV_DIR_FALLING },
+	};
+	u8 hit = 0;
+	unsigned int i;
+
+	if (!watch->enabled)
+		return;
+
+	if (raw > watch->value[0])
+		hit |= BIT(0);
+	if (raw < watch->value[1])
+		hit |= BIT(1);
+
+	if (watch->primed && timestamp > watch->prev_ts) {
+		u64 step = abs((int)raw - watch->prev_raw);
+		u64 rate = div64_u64(step * NSEC_PER_SEC,
+				     timestamp - watch->prev_ts);
+
+		if (raw > watch->prev_raw && rate > watch->value[2])
+			hit |= BIT(2);
+		if (raw < watch->prev_raw && rate > watch->value[3])
+			hit |= BIT(3);
+	}
+
+	watch->prev_raw = raw;
+	watch->prev_ts = timestamp;
+	watch->primed = true;
+
+	hit &= watch->enabled;
+
+	for (i = 0; i < ARRAY_SIZE(ev); i++) {
+		if ((hit & ~watch->asserted) & BIT(i))
+			iio_push_event(indio_dev,
+				       IIO_UNMOD_EVENT_CODE(chan->type,
+							    chan->channel,
+							    ev[i].type,
+							    ev[i].dir),
+				       timestamp);
+	}
+
+	watch->asserted = hit;
+}
+
+/* Keep the device awake for the whole capture instead of on every scan */
+static int ad7293_buffer_preenable(struct iio_dev *indio_dev)
+{
+	return ad7293_pm_get(iio_priv(indio_dev));
+}
+
+static int ad7293_buffer_postdisable(struct iio_dev *indio_dev)
+{
+	ad7293_pm_put(iio_priv(indio_dev));
+
+	return 0;
+}
+
+static const struct iio_buffer_setup_ops ad7293_buffer_setup_ops = {
+	.preenable = ad7293_buffer_preenable,
+	.postdisable = ad7293_buffer_postdisable,
+};
+
+/*
+ * Runs once update_scan_mode() has programmed the sequencer and settled the
+ * bandgaps. The scan becomes an offload message: the conversion command,
+ * then one 24-bit word per result whose data lands in the DMA stream.
+ */
+static int ad7293_offload_buffer_postenable(struct iio_dev *indio_dev)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+	struct spi_offload_trigger_config config = {
+		.type = SPI_OFFLOAD_TRIGGER_PERIODIC,
+		.periodic = {
+			.frequency_hz = st->offload_trigger_hz,
+		},
+	};
+	struct spi_transfer *xfer = &st->offload_xfers[1];
+	unsigned int bit, n = 0;
+	int ret;
+
+	memset(st->offload_xfers, 0, sizeof(st->offload_xfers));
+
+	/* Same conversion command and latency as a triggered scan */
+	st->offload_xfers[0] = st->scan_xfers[0];
+	st->offload_xfers[0].ptp_sts = NULL;
+
+	for_each_set_bit(bit, indio_dev->active_scan_mask, AD7293_NUM_ADC_CH) {
+		st->offload_tx[n] = (AD7293_READ |
+				     ad7293_ch_descs[bit].addr) << 16;
+
+		xfer[n].tx_buf = &st->offload_tx[n];
+		xfer[n].len = sizeof(st->offload_tx[n]);
+		xfer[n].bits_per_word = 24;
+		xfer[n].cs_change = 1;
+		xfer[n].speed_hz = st->read_hz;
+		xfer[n].offload_flags = SPI_OFFLOAD_XFER_RX_STREAM;
+		n++;
+	}
+
+	if (!n)
+		return -EINVAL;
+
+	xfer[n - 1].cs_change = 0;
+
+	spi_message_init_with_transfers(&st->offload_msg, st->offload_xfers,
+					n + 1);
+	st->offload_msg.offload = st->offload;
+
+	mutex_lock(&st->lock);
+
+	/* Conversion command and results share the same page */
+	ret = ad7293_page_select(st, AD7293_REG_CONV_CMD);
+	if (ret)
+		goto out;
+
+	ret = spi_optimize_message(st->spi, &st->offload_msg);
+	if (ret)
+		goto out;
+
+	ret = spi_offload_trigger_enable(st->offload, st->offload_trigger,
+					 &config);
+	if (ret) {
+		spi_unoptimize_message(&st->offload_msg);
+		goto out;
+	}
+
+	st->offload_running = true;
+out:
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+static int ad7293_offload_buffer_predisable(struct iio_dev *indio_dev)
+{
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	spi_offload_trigger_disable(st->offload, st->offload_trigger);
+	spi_unoptimize_message(&st->offload_msg);
+
+	mutex_lock(&st->lock);
+	st->offload_running = false;
+	mutex_unlock(&st->lock);
+
+	return 0;
+}
+
+static const struct iio_buffer_setup_ops ad7293_offload_buffer_setup_ops = {
+	.preenable = ad7293_buffer_preenable,
+	.postenable = ad7293_offload_buffer_postenable,
+	.predisable = ad7293_offload_buffer_predisable,
+	.postdisable = ad7293_buffer_postdisable,
+};
+
+static irqreturn_t ad7293_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct ad7293_state *st = iio_priv(indio_dev);
+	u16 seq[ARRAY_SIZE(ad7293_seq_regs)];
+	unsigned int bit, i = 0, n = 0;
+	s64 timestamp, mono, real, delta = 0;
+	ktime_t start = ktime_get();
+	unsigned long flags, due = 0;
+	int ret;
+
+	mutex_lock(&st->lock);
+
+	for_each_set_bit(bit, indio_dev->active_scan_mask, AD7293_NUM_ADC_CH) {
+		if (st->scan_left[bit]) {
+			st->scan_left[bit]--;
+			continue;
+		}
+
+		st->scan_left[bit] = st->scan_div[bit] - 1;
+		due |= BIT(bit);
+	}
+
+	if (!due) {
+		/* Nothing is due, the scan repeats the held results */
+		timestamp = iio_get_time_ns(indio_dev);
+		goto push;
+	}
+
+	/* The message and sequencer only change with the set of due channels */
+	if (due != st->scan_mask) {
+		ret = ad7293_scan_build(st, due, seq);
+		if (ret)
+			goto out;
+
+		/* The next trigger rebuilds both if the sequencer was not set */
+		ret = __ad7293_seq_set(st, seq);
+		if (ret) {
+			st->scan_mask = 0;
+			goto out;
+		}
+
+		st->scan_mask = due;
+	}
+
+	ret = ad7293_page_select(st, AD7293_REG_CONV_CMD);
+	if (ret)
+		goto out;
+
+	/*
+	 * The SPI core records, in CLOCK_REALTIME, when the conversion command
+	 * left the controller. Carry that instant over to the buffer and cache
+	 * clocks through the offset from references taken just before the
+	 * message. Controllers that cannot stamp transfers leave it cleared, in
+	 * which case the start of the message is used.
+	 */
+	memset(&st->scan_sts, 0, sizeof(st->scan_sts));
+	timestamp = iio_get_time_ns(indio_dev);
+	mono = ktime_get_ns();
+	real = ktime_get_real_ns();
+
+	ret = spi_sync(st->spi, &st->scan_msg);
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
+		goto out;
+	}
+
+	if (timespec64_to_ns(&st->scan_sts.post_ts))
+		delta = timespec64_to_ns(&st->scan_sts.post_ts) - real;
+
+	write_seqlock_irqsave(&st->latest_lock, flags);
+
+	/* Channels that were not due keep their previous result in the scan */
+	for_each_set_bit(bit, indio_dev->active_scan_mask, AD7293_NUM_ADC_CH) {
+		if (due & BIT(bit)) {
+			memcpy(&st->scan.channels[i], &st->scan_rx[n][1],
+			       sizeof(st->scan.channels[i]));
+
+			st->latest_raw[bit] = FIELD_GET(AD7293_REG_DATA_RAW_MSK,
+							get_unaligned_be16(&st->scan_rx[n][1]));
+			st->latest_ts[bit] = mono + delta;
+			st->latest_valid |= BIT(bit);
+			n++;
+		}
+		i++;
+	}
+
+	write_sequnlock_irqrestore(&st->latest_lock, flags);
+
+	/* Faults are reported before the scan reaches the buffer */
+	for_each_set_bit(bit, &due, AD7293_NUM_ADC_CH) {
+		const struct iio_chan_spec *chan = ad7293_scan_chan(indio_dev, bit);
+
+		if (chan)
+			__ad7293_watch_eval(indio_dev, chan, st->latest_raw[bit],
+					    timestamp + delta);
+	}
+
+push:
+	iio_push_to_buffers_with_timestamp(indio_dev, &st->scan,
+					   timestamp + delta);
+
+out:
+	mutex_unlock(&st->lock);
+	/* From waiting on the lock to the scan reaching the buffer */
+	ad7293_lat_record(st, AD7293_LAT_SCAN, start);
+	iio_trigger_notify_done(indio_dev->trig);
+
+	return IRQ_HANDLED;
+}
+
+static int ad7293_soft_reset(struct ad7293_state *st)
+{
+	int ret;
+
+	ret = __ad7293_spi_write(st, AD7293_REG_SOFT_RESET, 0x7293);
+	if (ret)
+		return ret;
+
+	return __ad7293_spi_write(st, AD7293_REG_SOFT_RESET, 0x0000);
+}
+
+static int ad7293_reset(struct ad7293_state *st)
+{
+	int ret;
+
+	if (st->gpio_reset) {
+		gpiod_set_value(st->gpio_reset, 0);
+		usleep_range(100, 1000);
+		gpiod_set_value(st->gpio_reset, 1);
+		usleep_range(100, 1000);
+
+		st->page_select = AD7293_PAGE_INVALID;
+		memset(st->seq, 0, sizeof(st->seq));
+
+		return 0;
+	}
+
+	/* Perform a software reset */
+	ret = ad7293_soft_reset(st);
+	st->page_select = AD7293_PAGE_INVALID;
+	memset(st->seq, 0, sizeof(st->seq));
+
+	return ret;
+}
+
+/*
+ * Read an optional per-channel array property. Returns 1 if the property is
+ * present and valid, 0 if it is absent or a negative error code.
+ */
+static int ad7293_fw_read_array(struct device *dev, const char *propname,
+				u32 *vals, unsigned int num, u32 max)
+{
+	unsigned int i;
+	int ret;
+
+	if (!device_property_present(dev, propname))
+		return 0;
+
+	ret = device_property_read_u32_array(dev, propname, vals, num);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to read %s\n", propname);
+
+	for (i = 0; i < num; i++) {
+		if (vals[i] > max)
+			return dev_err_probe(dev, -EINVAL,
+					     "invalid %s value: %u\n",
+					     propname, vals[i]);
+	}
+
+	return 1;
+}
+
+static irqreturn_t ad7293_busy_handler(int irq, void *data)
+{
+	struct ad7293_state *st = data;
+
+	complete(&st->conv_done);
+
+	return IRQ_HANDLED;
+}
+
+static int ad7293_properties_parse(struct ad7293_state *st)
+{
+	struct spi_device *spi = st->spi;
+	unsigned int i;
+	int ret;
+
+	st->gpio_reset = devm_gpiod_get_optional(&st->spi->dev, "reset",
+						 GPIOD_OUT_HIGH);
+	if (IS_ERR(st->gpio_reset))
+		return dev_err_probe(&spi->dev, PTR_ERR(st->gpio_reset),
+				     "failed to get the reset GPIO\n");
+
+	st->reg_avdd = devm_regulator_get(&spi->dev, "avdd");
+	if (IS_ERR(st->reg_avdd))
+		return dev_err_probe(&spi->dev, PTR_ERR(st->reg_avdd),
+				     "failed to get the AVDD voltage\n");
+
+	st->reg_vdrive = devm_regulator_get(&spi->dev, "vdrive");
+	if (IS_ERR(st->reg_vdrive))
+		return dev_err_probe(&spi->dev, PTR_ERR(st->reg_vdrive),
+				     "failed to get the VDRIVE voltage\n");
+
+	ret = ad7293_fw_read_array(&spi->dev,
+				   "adi,isense-shunt-resistor-micro-ohms",
+				   st->isense_shunt_uohm, AD7293_NUM_ISENSE,
+				   U32_MAX);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < AD7293_NUM_ISENSE; i++) {
+		if (!ret)
+			st->isense_shunt_uohm[i] = MICRO;
+		else if (!st->isense_shunt_uohm[i])
+			return dev_err_probe(&spi->dev, -EINVAL,
+					     "invalid ISENSE%u shunt resistor\n",
+					     i);
+	}
+
+	st->verify_writes = device_property_read_bool(&spi->dev,
+						      "adi,verify-writes");
+
+	ad7293_scale_init(st);
+
+	return 0;
+}
+
+static int ad7293_fw_config_apply(struct ad7293_state *st)
+{
+	struct ad7293_reg_write seq[AD7293_INIT_SEQ_MAX];
+	struct device *dev = &st->spi->dev;
+	u16 range0 = 0, range1 = 0, filter = 0, gain = 0;
+	u32 vals[AD7293_NUM_DAC], delay, func, pol = 0, busy;
+	unsigned int i, n = 0;
+	int ret;
+
+	/*
+	 * The device has just been reset, so every register holds its default
+	 * value and whole register writes are equivalent to read-modify-write
+	 * cycles. The sequence is grouped by page: configuration (0x2), offsets
+	 * (0xE) and finally the DAC codes (0x0), so that the DAC outputs are
+	 * only enabled once their range has been programmed.
+	 */
+	if (!device_property_read_u32(dev, "adi,digital-function-pins", &func)) {
+		device_property_read_u32(dev, "adi,digital-function-active-high",
+					 &pol);
+
+		if ((func | pol) & ~GENMASK(AD7293_NUM_GPIO - 1, 0))
+			return dev_err_probe(dev, -EINVAL,
+					     "invalid digital pin functions\n");
+
+		/* Only the pin carrying BUSY may end the wait for a conversion */
+		if (!device_property_read_u32(dev, "adi,busy-pin", &busy)) {
+			if (busy >= AD7293_NUM_GPIO || !(func & BIT(busy)))
+				return dev_err_probe(dev, -EINVAL,
+						     "BUSY pin is not a function pin\n");
+
+			st->busy_func = BIT(busy);
+		}
+
+		/* Polarity first, so the pins never glitch to the wrong level */
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_DIGITAL_FUNC_POL, pol };
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_DIGITAL_INOUT_FUNC, func };
+		st->gpio_func = func;
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,vin-range", vals, AD7293_NUM_VINX,
+				   ARRAY_SIZE(adc_range_table) - 1);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_VINX; i++) {
+			range1 |= AD7293_REG_VINX_RANGE_SET_CH_MSK(vals[i], i);
+			range0 |= AD7293_REG_VINX_RANGE_SET_CH_MSK(vals[i] >> 1, i);
+			st->vin_range[i] = vals[i];
+		}
+
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_VINX_RANGE0, range0 };
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_VINX_RANGE1, range1 };
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,vin-filter-enable", vals,
+				   AD7293_NUM_VINX, 1);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_VINX; i++)
+			filter |= vals[i] << i;
+
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_VINX_FILTER, filter };
+		st->vin_filter = filter;
+	}
+
+	if (!device_property_read_u32(dev, "adi,conversion-delay-us", &delay)) {
+		for (i = 0; i < ARRAY_SIZE(conv_delay_table); i++) {
+			if (conv_delay_table[i] == delay)
+				break;
+		}
+
+		if (i == ARRAY_SIZE(conv_delay_table))
+			return dev_err_probe(dev, -EINVAL,
+					     "invalid conversion delay: %u\n",
+					     delay);
+
+		seq[n++] = (struct ad7293_reg_write){
+			AD7293_REG_CONV_DELAY,
+			FIELD_PREP(AD7293_REG_CONV_DELAY_MSK, i)
+		};
+		st->conv_delay = i;
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,isense-gain", vals,
+				   AD7293_NUM_ISENSE,
+				   ARRAY_SIZE(isense_gain_table) - 1);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_ISENSE; i++) {
+			gain |= vals[i] << (4 * i);
+			st->isense_gain[i] = vals[i];
+		}
+
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_ISENSE_GAIN, gain };
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,vin-offset", vals,
+				   AD7293_NUM_VINX, AD7293_OFFSET_MAX);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_VINX; i++)
+			seq[n++] = (struct ad7293_reg_write){
+				AD7293_REG_VIN0_OFFSET + i, vals[i]
+			};
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,tsense-offset", vals,
+				   AD7293_NUM_TSENSE, AD7293_OFFSET_MAX);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_TSENSE; i++)
+			seq[n++] = (struct ad7293_reg_write){
+				AD7293_REG_TSENSE_INT_OFFSET + i, vals[i]
+			};
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,isense-offset", vals,
+				   AD7293_NUM_ISENSE, AD7293_OFFSET_MAX);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_ISENSE; i++)
+			seq[n++] = (struct ad7293_reg_write){
+				AD7293_REG_ISENSE0_OFFSET + i, vals[i]
+			};
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,dac-offset", vals, AD7293_NUM_DAC,
+				   ARRAY_SIZE(dac_offset_table) - 1);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_DAC; i++)
+			seq[n++] = (struct ad7293_reg_write){
+				ad7293_ch_offset(ad7293_dac_desc(i)),
+				FIELD_PREP(AD7293_REG_VOUT_OFFSET_MSK, vals[i])
+			};
+	}
+
+	ret = ad7293_fw_read_array(dev, "adi,dac-default", vals, AD7293_NUM_DAC,
+				   AD7293_DAC_MAX_CODE);
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		for (i = 0; i < AD7293_NUM_DAC; i++)
+			seq[n++] = (struct ad7293_reg_write){
+				ad7293_ch_result(ad7293_dac_desc(i)),
+				FIELD_PREP(AD7293_REG_DATA_RAW_MSK, vals[i])
+			};
+
+		seq[n++] = (struct ad7293_reg_write){
+			AD7293_REG_DAC_EN, GENMASK(AD7293_NUM_DAC - 1, 0)
+		};
+		st->dac_en = GENMASK(AD7293_NUM_DAC - 1, 0);
+	}
+
+	return __ad7293_spi_write_seq(st, seq, n);
+}
+
+static void ad7293_reg_disable(void *data)
+{
+	regulator_disable(data);
+}
+
+/*
+ * Check the link at a candidate rate with a DEVICE_ID read, the command byte
+ * being clocked at @cmd_hz and the ID shifted back at the current read rate.
+ * The ID register is common to all pages, so nothing is written at a rate
+ * before the device has decoded a command sent at that rate.
+ */
+static int ad7293_spi_rate_check(struct ad7293_state *st, u32 cmd_hz)
+{
+	struct spi_transfer t[] = {
+		{
+			.tx_buf = &st->data[0],
+			.len = 1,
+			.speed_hz = cmd_hz,
+		}, {
+			.rx_buf = &st->data[1],
+			.len = 2,
+			.speed_hz = st->read_hz,
+		},
+	};
+	int ret;
+
+	ad7293_frame_read(st->data, AD7293_REG_DEVICE_ID);
+
+	ret = spi_sync_transfer(st->spi, t, ARRAY_SIZE(t));
+	if (ret)
+		return ret;
+
+	return ad7293_frame_val(st->data, AD7293_REG_DEVICE_ID) ==
+	       AD7293_CHIP_ID;
+}
+
+/*
+ * Pick the fastest read and write clock rates the device handles on this
+ * board: reads must return the chip ID and a page written through the page
+ * select register must read back.
+ */
+static int ad7293_spi_rate_init(struct ad7293_state *st)
+{
+	struct spi_device *spi = st->spi;
+	u32 hz;
+	u16 val;
+	int ret;
+
+	st->read_hz = min_not_zero(spi->max_speed_hz, AD7293_SPI_READ_MAX_HZ);
+
+	while (1) {
+		ret = ad7293_spi_rate_check(st, st->read_hz);
+		if (ret < 0)
+			return ret;
+
+		if (ret)
+			break;
+
+		if (st->read_hz <= AD7293_SPI_SAFE_HZ) {
+			dev_err(&spi->dev, "Invalid Chip ID.\n");
+			return -EINVAL;
+		}
+
+		st->read_hz /= 2;
+	}
+
+	hz = min_not_zero(spi->max_speed_hz, AD7293_SPI_WRITE_MAX_HZ);
+
+	while (1) {
+		ret = ad7293_spi_rate_check(st, hz);
+		if (ret < 0)
+			return ret;
+
+		if (ret) {
+			st->write_hz = hz;
+
+			ret = __ad7293_spi_write(st, AD7293_REG_PAGE_SELECT,
+						 AD7293_SPI_TEST_PAGE);
+			if (ret)
+				return ret;
+
+			ret = __ad7293_spi_read(st, AD7293_REG_PAGE_SELECT,
+						&val);
+			if (ret)
+				return ret;
+
+			if (val == AD7293_SPI_TEST_PAGE)
+				break;
+
+			/* A garbled write may have selected any page */
+			st->page_select = AD7293_PAGE_INVALID;
+		}
+
+		if (hz <= AD7293_SPI_SAFE_HZ) {
+			dev_err(&spi->dev, "SPI write check failed\n");
+			return -EIO;
+		}
+
+		hz /= 2;
+	}
+
+	dev_dbg(&spi->dev, "SPI read %u Hz, write %u Hz\n", st->read_hz,
+		st->write_hz);
+
+	/* The test page is left selected, let the next access reselect */
+	st->page_select = AD7293_PAGE_INVALID;
+
+	return 0;
+}
+
+static int ad7293_init(struct ad7293_state *st)
+{
+	int ret;
+	struct spi_device *spi = st->spi;
+
+	ret = ad7293_properties_parse(st);
+	if (ret)
+		return ret;
+
+	ret = ad7293_reset(st);
+	if (ret)
+		return ret;
+
+	ret = regulator_enable(st->reg_avdd);
+	if (ret) {
+		dev_err(&spi->dev,
+			"Failed to enable specified AVDD Voltage!\n");
+		return ret;
+	}
+
+	ret = devm_add_action_or_reset(&spi->dev, ad7293_reg_disable,
+				       st->reg_avdd);
+	if (ret)
+		return ret;
+
+	ret = regulator_enable(st->reg_vdrive);
+	if (ret) {
+		dev_err(&spi->dev,
+			"Failed to enable specified VDRIVE Voltage!\n");
+		return ret;
+	}
+
+	ret = devm_add_action_or_reset(&spi->dev, ad7293_reg_disable,
+				       st->reg_vdrive);
+	if (ret)
+		return ret;
+
+	ret = regulator_get_voltage(st->reg_avdd);
+	if (ret < 0) {
+		dev_err(&spi->dev, "Failed to read avdd regulator: %d\n", ret);
+		return ret;
+	}
+
+	if (ret > 5500000 || ret < 4500000)
+		return -EINVAL;
+
+	ret = regulator_get_voltage(st->reg_vdrive);
+	if (ret < 0) {
+		dev_err(&spi->dev,
+			"Failed to read vdrive regulator: %d\n", ret);
+		return ret;
+	}
+	if (ret > 5500000 || ret < 1700000)
+		return -EINVAL;
+
+	/* Check Chip ID and pick the SPI clock rates */
+	ret = ad7293_spi_rate_init(st);
+	if (ret)
+		return ret;
+
+	return ad7293_fw_config_apply(st);
+}
+
+static const struct iio_info ad7293_info = {
+	.read_raw = ad7293_read_raw,
+	.write_raw = ad7293_write_raw,
+	.write_raw_get_fmt = ad7293_write_raw_get_fmt,
+	.read_avail = &ad7293_read_avail,
+	.update_scan_mode = ad7293_update_scan_mode,
+	.read_event_config = ad7293_read_event_config,
+	.write_event_config = ad7293_write_event_config,
+	.read_event_value = ad7293_read_event_value,
+	.write_event_value = ad7293_write_event_value,
+	.debugfs_reg_access = &ad7293_reg_access,
+};
+
+int ad7293_read_latest(struct iio_channel *chan, int *raw, s64 *timestamp)
+{
+	const struct iio_chan_spec *spec = chan->channel;
+	struct ad7293_state *st;
+	unsigned int seq;
+	int ret;
+
+	if (chan->indio_dev->info != &ad7293_info || spec->scan_index < 0 ||
+	    spec->scan_index >= AD7293_NUM_ADC_CH)
+		return -EINVAL;
+
+	st = iio_priv(chan->indio_dev);
+
+	do {
+		seq = read_seqbegin(&st->latest_lock);
+
+		ret = st->latest_valid & BIT(spec->scan_index) ? 0 : -ENODATA;
+		*raw = st->latest_raw[spec->scan_index];
+		if (timestamp)
+			*timestamp = st->latest_ts[spec->scan_index];
+	} while (read_seqretry(&st->latest_lock, seq));
+
+	return ret;
+}
+EXPORT_SYMBOL_NS_GPL(ad7293_read_latest, "IIO_AD7293");
+
+/*
+ * Convert the channels in @mask 2^AD7293_CALIB_AVG_LOG2 times within a single
+ * SPI message, each burst being one conversion command followed by the
+ * readback of every result, and accumulate the codes per scan index in @sum.
+ * The sequencer must already be programmed with @mask.
+ */
+static int __ad7293_calib_measure(struct ad7293_state *st, unsigned long mask,
+				  u32 *sum)
+{
+	unsigned int num = BIT(AD7293_CALIB_AVG_LOG2) * (hweight_long(mask) + 1);
+	unsigned int bit, i, n = 0;
+	struct spi_transfer *xfers;
+	u8 *buf;
+	int ret;
+
+	/* Conversion command and results share the same page */
+	ret = ad7293_page_select(st, AD7293_REG_CONV_CMD);
+	if (ret)
+		return ret;
+
+	xfers = kcalloc(num, sizeof(*xfers), GFP_KERNEL);
+	if (!xfers)
+		return -ENOMEM;
+
+	buf = kcalloc(num, 3, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto free_xfers;
+	}
+
+	for (i = 0; i < BIT(AD7293_CALIB_AVG_LOG2); i++) {
+		u8 *tx = &buf[3 * n];
+
+		xfers[n].tx_buf = tx;
+		xfers[n].len = ad7293_frame_write(tx, AD7293_REG_CONV_CMD,
+						  AD7293_CONV_CMD_VAL);
+		xfers[n].cs_change = 1;
+		xfers[n].speed_hz = st->write_hz;
+		xfers[n].cs_change_delay.value =
+			ad7293_conv_latency_us(st, hweight_long(mask),
+					       mask & GENMASK(AD7293_NUM_VINX - 1, 0));
+		xfers[n].cs_change_delay.unit = SPI_DELAY_UNIT_USECS;
+		n++;
+
+		for_each_set_bit(bit, &mask, AD7293_NUM_ADC_CH) {
+			tx = &buf[3 * n];
+
+			xfers[n].tx_buf = tx;
+			xfers[n].rx_buf = tx;
+			xfers[n].len = ad7293_frame_read(tx,
+							 ad7293_ch_result(&ad7293_ch_descs[bit]));
+			xfers[n].cs_change = 1;
+			xfers[n].speed_hz = st->read_hz;
+			n++;
+		}
+	}
+
+	xfers[n - 1].cs_change = 0;
+
+	ret = spi_sync_transfer(st->spi, xfers, n);
+	if (ret) {
+		st->page_select = AD7293_PAGE_INVALID;
+		goto free_buf;
+	}
+
+	for (i = 0, n = 0; i < BIT(AD7293_CALIB_AVG_LOG2); i++) {
+		/* Skip the conversion command */
+		n++;
+
+		for_each_set_bit(bit, &mask, AD7293_NUM_ADC_CH) {
+			sum[bit] += FIELD_GET(AD7293_REG_DATA_RAW_MSK,
+					      get_unaligned_be16(&buf[3 * n + 1]));
+			n++;
+		}
+	}
+
+free_buf:
+	kfree(buf);
+free_xfers:
+	kfree(xfers);
+
+	return ret;
+}
+
+/*
+ * Null the offset of the VINx and ISENSE channels in @mask, the caller holding
+ * their inputs at zero. The offsets are cleared, all channels are converted
+ * together and the corrections are written back in one message. Channels out
+ * of @mask keep their offset, so a board can be calibrated one group of
+ * inputs at a time.
+ */
+static int __ad7293_calibrate(struct ad7293_state *st, unsigned long mask)
+{
+	struct ad7293_reg_write wr[AD7293_NUM_VINX + AD7293_NUM_ISENSE];
+	u16 seq[ARRAY_SIZE(ad7293_seq_regs)] = {};
+	u32 sum[AD7293_NUM_ADC_CH] = {};
+	unsigned int bit, n = 0;
+	u16 isense = 0;
+	int ret, code, zero;
+
+	for_each_set_bit(bit, &mask, AD7293_NUM_ADC_CH) {
+		const struct ad7293_ch_desc *desc = &ad7293_ch_descs[bit];
+
+		seq[ad7293_seq_idx(desc)] |= desc->seq_bit;
+		isense |= desc->isense_bg;
+		wr[n++] = (struct ad7293_reg_write){ ad7293_ch_offset(desc), 0 };
+	}
+
+	ret = __ad7293_spi_write_seq(st, wr, n);
+	if (ret)
+		return ret;
+
+	ret = __ad7293_seq_set(st, seq);
+	if (ret)
+		return ret;
+
+	ret = __ad7293_bg_enable(st, 0, isense);
+	if (ret)
+		return ret;
+
+	ret = __ad7293_calib_measure(st, mask, sum);
+	if (ret)
+		return ret;
+
+	n = 0;
+	for_each_set_bit(bit, &mask, AD7293_NUM_ADC_CH) {
+		code = DIV_ROUND_CLOSEST(sum[bit], BIT(AD7293_CALIB_AVG_LOG2));
+		/* Differential VINx inputs are coded in offset binary */
+		zero = bit < AD7293_NUM_VINX && (st->vin_diff & BIT(bit)) ?
+		       BIT(AD7293_ADC_RESOLUTION - 1) : 0;
+
+		/* The offset registers hold a two's complement correction */
+		wr[n++] = (struct ad7293_reg_write){
+			ad7293_ch_offset(&ad7293_ch_descs[bit]),
+			(u8)clamp(zero - code, S8_MIN, S8_MAX)
+		};
+	}
+
+	return __ad7293_spi_write_seq(st, wr, n);
+}
+
+/* DAC offset registers only hold the offset field, the other bits reserved */
+static bool ad7293_is_dac_offset(unsigned int reg)
+{
+	return reg >= AD7293_REG_UNI_VOUT0_OFFSET &&
+	       reg <= AD7293_REG_BI_VOUT3_OFFSET;
+}
+
+static int __ad7293_calib_export(struct ad7293_state *st,
+				 struct ad7293_calib_blob *blob)
+{
+	unsigned int i;
+	int ret;
+	u16 val;
+
+	blob->chip_id = cpu_to_be16(AD7293_CHIP_ID);
+	blob->version = AD7293_CALIB_VERSION;
+	blob->num = ARRAY_SIZE(ad7293_offset_regs);
+
+	for (i = 0; i < ARRAY_SIZE(ad7293_offset_regs); i++) {
+		ret = __ad7293_spi_read(st, ad7293_offset_regs[i], &val);
+		if (ret)
+			return ret;
+
+		if (ad7293_is_dac_offset(ad7293_offset_regs[i]))
+			val &= AD7293_REG_VOUT_OFFSET_MSK;
+
+		blob->offset[i] = val;
+	}
+
+	return 0;
+}
+
+static int __ad7293_calib_import(struct ad7293_state *st,
+				 const struct ad7293_calib_blob *blob)
+{
+	struct ad7293_reg_write seq[ARRAY_SIZE(ad7293_offset_regs)];
+	unsigned int i, reg;
+	int ret;
+
+	if (be16_to_cpu(blob->chip_id) != AD7293_CHIP_ID ||
+	    blob->version != AD7293_CALIB_VERSION ||
+	    blob->num != ARRAY_SIZE(ad7293_offset_regs))
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(ad7293_offset_regs); i++) {
+		reg = ad7293_offset_regs[i];
+
+		/* Only the offset field of the DAC registers may be set */
+		if (ad7293_is_dac_offset(reg) &&
+		    blob->offset[i] & ~AD7293_REG_VOUT_OFFSET_MSK)
+			return -EINVAL;
+
+		seq[i] = (struct ad7293_reg_write){ reg, blob->offset[i] };
+	}
+
+	if (!st->verify_writes)
+		return __ad7293_spi_write_seq(st, seq, ARRAY_SIZE(seq));
+
+	/* Read back one register at a time, like any other offset update */
+	for (i = 0; i < ARRAY_SIZE(seq); i++) {
+		ret = __ad7293_spi_write_verify(st, seq[i].reg, seq[i].val);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void ad7293_page_work(struct work_struct *work)
+{
+	struct ad7293_state *st = container_of(to_delayed_work(work),
+					       struct ad7293_state, page_work);
+	struct device *dev = &st->spi->dev;
+	unsigned int interval_ms;
+
+	/* Do not wake the device up only to check it */
+	if (pm_runtime_get_if_active(dev) > 0) {
+		mutex_lock(&st->lock);
+		__ad7293_page_verify(st);
+		mutex_unlock(&st->lock);
+
+		pm_runtime_mark_last_busy(dev);
+		pm_runtime_put_autosuspend(dev);
+	}
+
+	interval_ms = READ_ONCE(st->page_check_ms);
+	if (interval_ms)
+		schedule_delayed_work(&st->page_work,
+				      msecs_to_jiffies(interval_ms));
+}
+
+static int ad7293_page_check_get(void *arg, u64 *val)
+{
+	struct ad7293_state *st = arg;
+
+	*val = READ_ONCE(st->page_check_ms);
+
+	return 0;
+}
+
+static int ad7293_page_check_set(void *arg, u64 val)
+{
+	struct ad7293_state *st = arg;
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(st->page_check_ms, val);
+
+	if (val)
+		mod_delayed_work(system_wq, &st->page_work,
+				 msecs_to_jiffies(val));
+	else
+		cancel_delayed_work_sync(&st->page_work);
+
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(ad7293_page_check_fops, ad7293_page_check_get,
+			 ad7293_page_check_set, "%llu\n");
+
+/* Takes a mask of VINx and ISENSE scan indexes to calibrate */
+static int ad7293_calibrate_set(void *arg, u64 val)
+{
+	struct iio_dev *indio_dev = arg;
+	struct ad7293_state *st = iio_priv(indio_dev);
+	int ret;
+
+	if (!val || val & ~AD7293_CALIB_CH_MSK)
+		return -EINVAL;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	/* The sequencer is reprogrammed, so no capture may be running */
+	ret = iio_device_claim_direct_mode(indio_dev);
+	if (ret)
+		goto put;
+
+	mutex_lock(&st->lock);
+	ret = __ad7293_calibrate(st, val);
+	mutex_unlock(&st->lock);
+
+	iio_device_release_direct_mode(indio_dev);
+put:
+	ad7293_pm_put(st);
+
+	return ret;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(ad7293_calibrate_fops, NULL, ad7293_calibrate_set,
+			 "%llu\n");
+
+static ssize_t ad7293_calib_read(struct file *file, char __user *userbuf,
+				 size_t count, loff_t *ppos)
+{
+	struct ad7293_state *st = file->private_data;
+	struct ad7293_calib_blob blob;
+	int ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	mutex_lock(&st->lock);
+	ret = __ad7293_calib_export(st, &blob);
+	mutex_unlock(&st->lock);
+
+	ad7293_pm_put(st);
+	if (ret)
+		return ret;
+
+	return simple_read_from_buffer(userbuf, count, ppos, &blob,
+				       sizeof(blob));
+}
+
+/* The coefficients are only applied as a whole, in a single write */
+static ssize_t ad7293_calib_write(struct file *file,
+				  const char __user *userbuf,
+				  size_t count, loff_t *ppos)
+{
+	struct ad7293_state *st = file->private_data;
+	struct ad7293_calib_blob blob;
+	int ret;
+
+	if (*ppos || count != sizeof(blob))
+		return -EINVAL;
+
+	if (copy_from_user(&blob, userbuf, count))
+		return -EFAULT;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	mutex_lock(&st->lock);
+	ret = __ad7293_calib_import(st, &blob);
+	mutex_unlock(&st->lock);
+
+	ad7293_pm_put(st);
+	if (ret)
+		return ret;
+
+	*ppos += count;
+
+	return count;
+}
+
+static const struct file_operations ad7293_calib_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = ad7293_calib_read,
+	.write = ad7293_calib_write,
+	.llseek = default_llseek,
+};
+
+/* One line per operation, then one count per bucket */
+static int ad7293_lat_show(struct seq_file *s, void *unused)
+{
+	struct ad7293_state *st = s->private;
+	u32 hist[AD7293_LAT_BUCKETS];
+	unsigned int op, i;
+
+	seq_puts(s, "# op, calls under 1 2 4 ... us, then from");
+	seq_printf(s, " %lu us\n", BIT(AD7293_LAT_BUCKETS - 2));
+
+	for (op = 0; op < AD7293_LAT_NUM; op++) {
+		spin_lock(&st->lat_lock);
+		memcpy(hist, st->lat_hist[op], sizeof(hist));
+		spin_unlock(&st->lat_lock);
+
+		seq_printf(s, "%s", ad7293_lat_names[op]);
+		for (i = 0; i < AD7293_LAT_BUCKETS; i++)
+			seq_printf(s, " %u", hist[i]);
+		seq_puts(s, "\n");
+	}
+
+	return 0;
+}
+
+static int ad7293_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ad7293_lat_show, inode->i_private);
+}
+
+/* Any write clears all histograms */
+static ssize_t ad7293_lat_write(struct file *file, const char __user *userbuf,
+				size_t count, loff_t *ppos)
+{
+	struct ad7293_state *st = ((struct seq_file *)file->private_data)->private;
+
+	spin_lock(&st->lat_lock);
+	memset(st->lat_hist, 0, sizeof(st->lat_hist));
+	spin_unlock(&st->lat_lock);
+
+	return count;
+}
+
+static const struct file_operations ad7293_lat_fops = {
+	.owner = THIS_MODULE,
+	.open = ad7293_lat_open,
+	.read = seq_read,
+	.write = ad7293_lat_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Register shown in column @col of the channels file, 0 if there is none */
+static unsigned int ad7293_ch_dump_reg(const struct ad7293_ch_desc *desc,
+				       unsigned int col)
+{
+	if (col == 0)
+		return ad7293_ch_result(desc);
+	if (col == 1)
+		return ad7293_ch_offset(desc);
+	if (!ad7293_ch_has_limits(desc))
+		return 0;
+
+	return ad7293_ch_limit(desc, col - 2);
+}
+
+/*
+ * One line per channel of the descriptor table, page 1 monitors included:
+ * result, offset, then the limit, hysteresis and min/max registers. Registers
+ * are read one column at a time, which keeps page switches to a few per
+ * column instead of several per channel.
+ */
+static int ad7293_channels_show(struct seq_file *s, void *unused)
+{
+	struct ad7293_state *st = s->private;
+	u16 (*vals)[AD7293_NUM_LIMITS + 2];
+	unsigned int i, col, reg;
+	int ret;
+
+	vals = kcalloc(AD7293_NUM_CH, sizeof(*vals), GFP_KERNEL);
+	if (!vals)
+		return -ENOMEM;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		goto free_vals;
+
+	mutex_lock(&st->lock);
+	for (col = 0; col < ARRAY_SIZE(vals[0]) && !ret; col++) {
+		for (i = 0; i < AD7293_NUM_CH && !ret; i++) {
+			reg = ad7293_ch_dump_reg(&ad7293_ch_descs[i], col);
+			if (reg)
+				ret = __ad7293_spi_read(st, reg, &vals[i][col]);
+		}
+	}
+	mutex_unlock(&st->lock);
+
+	ad7293_pm_put(st);
+	if (ret)
+		goto free_vals;
+
+	seq_puts(s, "# channel, result, offset, high, low, hyst, min, max\n");
+
+	for (i = 0; i < AD7293_NUM_CH; i++) {
+		seq_printf(s, "%s 0x%04x 0x%02x", ad7293_ch_descs[i].name,
+			   vals[i][0], vals[i][1]);
+		for (col = 2; col < ARRAY_SIZE(vals[0]); col++) {
+			if (ad7293_ch_dump_reg(&ad7293_ch_descs[i], col))
+				seq_printf(s, " 0x%04x", vals[i][col]);
+		}
+		seq_puts(s, "\n");
+	}
+
+free_vals:
+	kfree(vals);
+
+	return ret;
+}
+
+static int ad7293_channels_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ad7293_channels_show, inode->i_private);
+}
+
+static const struct file_operations ad7293_channels_fops = {
+	.owner = THIS_MODULE,
+	.open = ad7293_channels_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void ad7293_debugfs_init(struct iio_dev *indio_dev)
+{
+	struct dentry *d = iio_get_debugfs_dentry(indio_dev);
+	struct ad7293_state *st = iio_priv(indio_dev);
+
+	debugfs_create_u32("resume_cost_us", 0400, d, &st->resume_cost_us);
+	debugfs_create_file_unsafe("page_check_interval_ms", 0600, d, st,
+				   &ad7293_page_check_fops);
+	debugfs_create_u32("page_mismatch_count", 0400, d, &st->page_mismatch);
+	debugfs_create_u32("verify_fail_count", 0400, d, &st->verify_fail);
+	debugfs_create_u32("page_switch_count", 0400, d, &st->page_switches);
+	debugfs_create_u32("reg_read_count", 0400, d, &st->reg_reads);
+	debugfs_create_file_unsafe("calibrate", 0200, d, indio_dev,
+				   &ad7293_calibrate_fops);
+	debugfs_create_file("calibration", 0600, d, st, &ad7293_calib_fops);
+	debugfs_create_file("latency_histogram", 0600, d, st, &ad7293_lat_fops);
+	debugfs_create_file("channels", 0400, d, st, &ad7293_channels_fops);
+}
+
+static int ad7293_gpio_init_valid_mask(struct gpio_chip *gc,
+				       unsigned long *valid_mask,
+				       unsigned int ngpios)
+{
+	struct ad7293_state *st = gpiochip_get_data(gc);
+
+	/* Pins driven by an alert or busy function are not GPIOs */
+	*valid_mask &= ~(unsigned long)st->gpio_func;
+
+	return 0;
+}
+
+static int ad7293_gpio_get_direction(struct gpio_chip *gc, unsigned int offset)
+{
+	struct ad7293_state *st = gpiochip_get_data(gc);
+
+	if (st->gpio_out_en & BIT(offset))
+		return GPIO_LINE_DIRECTION_OUT;
+
+	return GPIO_LINE_DIRECTION_IN;
+}
+
+static int ad7293_gpio_set_dir(struct ad7293_state *st, unsigned int offset,
+			       bool output)
+{
+	u16 out_en = (st->gpio_out_en & ~BIT(offset)) | (output << offset);
+	int ret;
+
+	ret = __ad7293_spi_write(st, AD7293_REG_DIGITAL_OUT_EN, out_en);
+	if (!ret)
+		st->gpio_out_en = out_en;
+
+	return ret;
+}
+
+static int ad7293_gpio_direction_input(struct gpio_chip *gc,
+				       unsigned int offset)
+{
+	struct ad7293_state *st = gpiochip_get_data(gc);
+	int ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	mutex_lock(&st->lock);
+	ret = ad7293_gpio_set_dir(st, offset, false);
+	mutex_unlock(&st->lock);
+
+	ad7293_pm_put(st);
+
+	return ret;
+}
+
+static int ad7293_gpio_direction_output(struct gpio_chip *gc,
+					unsigned int offset, int value)
+{
+	struct ad7293_state *st = gpiochip_get_data(gc);
+	int ret;
+	u16 out;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	mutex_lock(&st->lock);
+
+	/* Latch the level before the driver is enabled */
+	out = (st->gpio_out & ~BIT(offset)) | (!!value << offset);
+	ret = __ad7293_spi_write(st, AD7293_REG_DIGITAL_INOUT, out);
+	if (ret)
+		goto exit;
+
+	st->gpio_out = out;
+	ret = ad7293_gpio_set_dir(st, offset, true);
+
+exit:
+	mutex_unlock(&st->lock);
+	ad7293_pm_put(st);
+
+	return ret;
+}
+
+static int ad7293_gpio_get_multiple(struct gpio_chip *gc, unsigned long *mask,
+				    unsigned long *bits)
+{
+	struct ad7293_state *st = gpiochip_get_data(gc);
+	u16 val;
+	int ret;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	ret = ad7293_spi_read(st, AD7293_REG_DIGITAL_INOUT, &val);
+	ad7293_pm_put(st);
+	if (ret)
+		return ret;
+
+	*bits = (*bits & ~*mask) | (val & *mask);
+
+	return 0;
+}
+
+static int ad7293_gpio_get(struct gpio_chip *gc, unsigned int offset)
+{
+	unsigned long mask = BIT(offset), bits = 0;
+	int ret;
+
+	ret = ad7293_gpio_get_multiple(gc, &mask, &bits);
+	if (ret)
+		return ret;
+
+	return !!bits;
+}
+
+/*
+ * All the pins share one data register, so any number of them is updated
+ * with a single write and the write is skipped when no level changes.
+ */
+static int ad7293_gpio_set_multiple(struct gpio_chip *gc, unsigned long *mask,
+				    unsigned long *bits)
+{
+	struct ad7293_state *st = gpiochip_get_data(gc);
+	int ret;
+	u16 out;
+
+	ret = ad7293_pm_get(st);
+	if (ret)
+		return ret;
+
+	mutex_lock(&st->lock);
+
+	out = (st->gpio_out & ~*mask) | (*bits & *mask);
+	if (out != st->gpio_out) {
+		ret = __ad7293_spi_write(st, AD7293_REG_DIGITAL_INOUT, out);
+		if (!ret)
+			st->gpio_out = out;
+	}
 
-#define AD7293_CHAN_ADC(_channel) {					\
-	.type = IIO_VOLTAGE,						\
-	.output = 0,							\
-	.indexed = 1,							\
-	.channel = _channel,						\
-	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
-			      BIT(IIO_CHAN_INFO_SCALE) |		\
-			      BIT(IIO_CHAN_INFO_OFFSET),		\
-	.info_mask_shared_by_type_available = BIT(IIO_CHAN_INFO_SCALE)	\
-}
+	mutex_unlock(&st->lock);
+	ad7293_pm_put(st);
 
-#define AD7293_CHAN_DAC(_channel) {					\
-	.type = IIO_VOLTAGE,						\
-	.output = 1,							\
-	.indexed = 1,							\
-	.channel = _channel,						\
-	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
-			      BIT(IIO_CHAN_INFO_OFFSET),		\
-	.info_mask_shared_by_type_available = BIT(IIO_CHAN_INFO_OFFSET)	\
+	return ret;
 }
 
-#define AD7293_CHAN_ISENSE(_channel) {					\
-	.type = IIO_CURRENT,						\
-	.output = 0,							\
-	.indexed = 1,							\
-	.channel = _channel,						\
-	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
-			      BIT(IIO_CHAN_INFO_OFFSET) |		\
-			      BIT(IIO_CHAN_INFO_SCALE),			\
-	.info_mask_shared_by_type_available = BIT(IIO_CHAN_INFO_SCALE)	\
+static int ad7293_gpio_set(struct gpio_chip *gc, unsigned int offset,
+			   int value)
+{
+	unsigned long mask = BIT(offset), bits = value ? BIT(offset) : 0;
+
+	return ad7293_gpio_set_multiple(gc, &mask, &bits);
 }
 
-#define AD7293_CHAN_TEMP(_channel) {					\
-	.type = IIO_TEMP,						\
-	.output = 0,							\
-	.indexed = 1,							\
-	.channel = _channel,						\
-	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |			\
-			      BIT(IIO_CHAN_INFO_OFFSET),		\
-	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE)		\
+static int ad7293_gpio_init(struct ad7293_state *st)
+{
+	struct device *dev = &st->spi->dev;
+
+	if (!device_property_present(dev, "gpio-controller"))
+		return 0;
+
+	st->gc.label = dev_name(dev);
+	st->gc.parent = dev;
+	st->gc.owner = THIS_MODULE;
+	st->gc.base = -1;
+	st->gc.ngpio = AD7293_NUM_GPIO;
+	st->gc.can_sleep = true;
+	st->gc.init_valid_mask = ad7293_gpio_init_valid_mask;
+	st->gc.get_direction = ad7293_gpio_get_direction;
+	st->gc.direction_input = ad7293_gpio_direction_input;
+	st->gc.direction_output = ad7293_gpio_direction_output;
+	st->gc.get = ad7293_gpio_get;
+	st->gc.get_multiple = ad7293_gpio_get_multiple;
+	st->gc.set = ad7293_gpio_set;
+	st->gc.set_multiple = ad7293_gpio_set_multiple;
+
+	return devm_gpiochip_add_data(dev, &st->gc, st);
 }
 
-static const struct iio_chan_spec ad7293_channels[] = {
-	AD7293_CHAN_ADC(0),
-	AD7293_CHAN_ADC(1),
-	AD7293_CHAN_ADC(2),
-	AD7293_CHAN_ADC(3),
-	AD7293_CHAN_ISENSE(0),
-	AD7293_CHAN_ISENSE(1),
-	AD7293_CHAN_ISENSE(2),
-	AD7293_CHAN_ISENSE(3),
-	AD7293_CHAN_TEMP(0),
-	AD7293_CHAN_TEMP(1),
-	AD7293_CHAN_TEMP(2),
-	AD7293_CHAN_DAC(0),
-	AD7293_CHAN_DAC(1),
-	AD7293_CHAN_DAC(2),
-	AD7293_CHAN_DAC(3),
-	AD7293_CHAN_DAC(4),
-	AD7293_CHAN_DAC(5),
-	AD7293_CHAN_DAC(6),
-	AD7293_CHAN_DAC(7)
+static const struct spi_offload_config ad7293_offload_config = {
+	.capability_flags = SPI_OFFLOAD_CAP_TRIGGER |
+			    SPI_OFFLOAD_CAP_RX_STREAM_DMA,
 };
 
-static int ad7293_soft_reset(struct ad7293_state *st)
+static int ad7293_offload_setup(struct iio_dev *indio_dev)
 {
+	struct ad7293_state *st = iio_priv(indio_dev);
+	struct device *dev = &st->spi->dev;
+	struct iio_chan_spec *chans;
+	struct dma_chan *rx_dma;
+	unsigned int i;
 	int ret;
 
-	ret = __ad7293_spi_write(st, AD7293_REG_SOFT_RESET, 0x7293);
-	if (ret)
-		return ret;
+	st->offload_trigger = devm_spi_offload_trigger_get(dev, st->offload,
+							   SPI_OFFLOAD_TRIGGER_PERIODIC);
+	if (IS_ERR(st->offload_trigger))
+		return dev_err_probe(dev, PTR_ERR(st->offload_trigger),
+				     "failed to get offload trigger\n");
 
-	return __ad7293_spi_write(st, AD7293_REG_SOFT_RESET, 0x0000);
-}
+	ret = ad7293_set_sample_freq(st, AD7293_OFFLOAD_DEFAULT_HZ);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to set sample rate\n");
+
+	rx_dma = devm_spi_offload_rx_stream_request_dma_chan(dev, st->offload);
+	if (IS_ERR(rx_dma))
+		return dev_err_probe(dev, PTR_ERR(rx_dma),
+				     "failed to get offload RX DMA\n");
+
+	/*
+	 * Scans leave the CPU out of the loop, so there is no timestamp to
+	 * add: drop the last channel and switch to the stream layout.
+	 */
+	chans = devm_kmemdup(dev, ad7293_channels,
+			     sizeof(ad7293_channels) - sizeof(chans[0]),
+			     GFP_KERNEL);
+	if (!chans)
+		return -ENOMEM;
 
-static int ad7293_reset(struct ad7293_state *st)
-{
-	if (st->gpio_reset) {
-		gpiod_set_value(st->gpio_reset, 0);
-		usleep_range(100, 1000);
-		gpiod_set_value(st->gpio_reset, 1);
-		usleep_range(100, 1000);
+	for (i = 0; i < ARRAY_SIZE(ad7293_channels) - 1; i++) {
+		if (chans[i].scan_index < 0)
+			continue;
 
-		return 0;
+		chans[i].scan_type = ad7293_offload_scan_type;
+		chans[i].info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ);
 	}
 
-	/* Perform a software reset */
-	return ad7293_soft_reset(st);
+	indio_dev->channels = chans;
+	indio_dev->num_channels = ARRAY_SIZE(ad7293_channels) - 1;
+	indio_dev->setup_ops = &ad7293_offload_buffer_setup_ops;
+
+	return devm_iio_dmaengine_buffer_setup_with_handle(dev, indio_dev, rx_dma,
+							   IIO_BUFFER_DIRECTION_IN);
 }
 
-static int ad7293_properties_parse(struct ad7293_state *st)
+/*
+ * Captures stream through DMA when the SPI controller can replay the scan on
+ * its own, and go through a triggered buffer otherwise.
+ */
+static int ad7293_buffer_setup(struct iio_dev *indio_dev)
 {
-	struct spi_device *spi = st->spi;
-
-	st->gpio_reset = devm_gpiod_get_optional(&st->spi->dev, "reset",
-						 GPIOD_OUT_HIGH);
-	if (IS_ERR(st->gpio_reset))
-		return dev_err_probe(&spi->dev, PTR_ERR(st->gpio_reset),
-				     "failed to get the reset GPIO\n");
+	struct ad7293_state *st = iio_priv(indio_dev);
+	struct device *dev = &st->spi->dev;
+	int ret;
 
-	st->reg_avdd = devm_regulator_get(&spi->dev, "avdd");
-	if (IS_ERR(st->reg_avdd))
-		return dev_err_probe(&spi->dev, PTR_ERR(st->reg_avdd),
-				     "failed to get the AVDD voltage\n");
+	st->offload = devm_spi_offload_get(dev, st->spi, &ad7293_offload_config);
+	ret = PTR_ERR_OR_ZERO(st->offload);
+	if (ret == -ENODEV) {
+		st->offload = NULL;
 
-	st->reg_vdrive = devm_regulator_get(&spi->dev, "vdrive");
-	if (IS_ERR(st->reg_vdrive))
-		return dev_err_probe(&spi->dev, PTR_ERR(st->reg_vdrive),
-				     "failed to get the VDRIVE voltage\n");
+		return devm_iio_triggered_buffer_setup(dev, indio_dev, NULL,
+						       ad7293_trigger_handler,
+						       &ad7293_buffer_setup_ops);
+	}
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to get SPI offload\n");
 
-	return 0;
+	return ad7293_offload_setup(indio_dev);
 }
 
-static void ad7293_reg_disable(void *data)
+/* Driver state before the device is touched, shared with the KUnit suite */
+static void ad7293_state_init(struct ad7293_state *st, struct spi_device *spi)
 {
-	regulator_disable(data);
+	unsigned int i;
+
+	st->spi = spi;
+	st->page_select = AD7293_PAGE_INVALID;
+	st->read_hz = min_not_zero(spi->max_speed_hz, AD7293_SPI_SAFE_HZ);
+	st->write_hz = st->read_hz;
+
+	for (i = 0; i < AD7293_NUM_ADC_CH; i++)
+		st->scan_div[i] = 1;
+
+	mutex_init(&st->lock);
+	spin_lock_init(&st->lat_lock);
+	init_completion(&st->conv_done);
+	seqlock_init(&st->latest_lock);
 }
 
-static int ad7293_init(struct ad7293_state *st)
+static int ad7293_probe(struct spi_device *spi)
 {
+	struct iio_dev *indio_dev;
+	struct ad7293_state *st;
 	int ret;
-	u16 chip_id;
-	struct spi_device *spi = st->spi;
 
-	ret = ad7293_properties_parse(st);
+	indio_dev = devm_iio_device_alloc(&spi->dev, sizeof(*st));
+	if (!indio_dev)
+		return -ENOMEM;
+
+	st = iio_priv(indio_dev);
+
+	indio_dev->info = &ad7293_info;
+	indio_dev->name = "ad7293";
+	indio_dev->channels = ad7293_channels;
+	indio_dev->num_channels = ARRAY_SIZE(ad7293_channels);
+
+	ad7293_state_init(st, spi);
+
+	ret = ad7293_init(st);
 	if (ret)
 		return ret;
 
-	ret = ad7293_reset(st);
+	if (spi->irq > 0 && !st->busy_func) {
+		dev_warn(&spi->dev,
+			 "no BUSY pin selected, ignoring the IRQ\n");
+	} else if (spi->irq > 0) {
+		ret = devm_request_irq(&spi->dev, spi->irq, ad7293_busy_handler,
+				       0, indio_dev->name, st);
+		if (ret)
+			return dev_err_probe(&spi->dev, ret,
+					     "failed to request BUSY IRQ\n");
+
+		st->busy_irq = true;
+	}
+
+	ret = ad7293_buffer_setup(indio_dev);
 	if (ret)
 		return ret;
 
-	ret = regulator_enable(st->reg_avdd);
-	if (ret) {
-		dev_err(&spi->dev,
-			"Failed to enable specified AVDD Voltage!\n");
-		return ret;
-	}
+	spi_set_drvdata(spi, indio_dev);
 
-	ret = devm_add_action_or_reset(&spi->dev, ad7293_reg_disable,
-				       st->reg_avdd);
+	ret = pm_runtime_set_active(&spi->dev);
 	if (ret)
 		return ret;
 
-	ret = regulator_enable(st->reg_vdrive);
-	if (ret) {
-		dev_err(&spi->dev,
-			"Failed to enable specified VDRIVE Voltage!\n");
+	pm_runtime_set_autosuspend_delay(&spi->dev, AD7293_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(&spi->dev);
+
+	ret = devm_pm_runtime_enable(&spi->dev);
+	if (ret)
 		return ret;
-	}
 
-	ret = devm_add_action_or_reset(&spi->dev, ad7293_reg_disable,
-				       st->reg_vdrive);
+	/* The GPIO callbacks resume the device, so runtime PM comes first */
+	ret = ad7293_gpio_init(st);
 	if (ret)
 		return ret;
 
-	ret = regulator_get_voltage(st->reg_avdd);
-	if (ret < 0) {
-		dev_err(&spi->dev, "Failed to read avdd regulator: %d\n", ret);
+	ret = devm_delayed_work_autocancel(&spi->dev, &st->page_work,
+					   ad7293_page_work);
+	if (ret)
 		return ret;
-	}
 
-	if (ret > 5500000 || ret < 4500000)
-		return -EINVAL;
+	/* Consumers described in firmware find the channels on their own */
+	if (!dev_fwnode(&spi->dev)) {
+		ret = devm_iio_map_array_register(&spi->dev, indio_dev,
+						  ad7293_default_maps);
+		if (ret)
+			return ret;
+	}
 
-	ret = regulator_get_voltage(st->reg_vdrive);
-	if (ret < 0) {
-		dev_err(&spi->dev,
-			"Failed to read vdrive regulator: %d\n", ret);
+	ret = devm_iio_device_register(&spi->dev, indio_dev);
+	if (ret)
 		return ret;
+
+	ad7293_debugfs_init(indio_dev);
+
+	return 0;
+}
+
+/*
+ * Park the sensor bandgaps and snooze the DACs that are not enabled. The
+ * reference bandgaps are only turned off when no DAC is driving its output,
+ * as the enabled DACs must keep their level while the device is idle.
+ */
+static int ad7293_runtime_suspend(struct device *dev)
+{
+	struct ad7293_state *st = iio_priv(dev_get_drvdata(dev));
+	struct ad7293_reg_write seq[5];
+	unsigned int n = 0;
+	u8 snooze = ~st->dac_en;
+	int ret;
+
+	mutex_lock(&st->lock);
+
+	if (!st->dac_en) {
+		ret = __ad7293_spi_read(st, AD7293_REG_BG_EN, &st->bg_en);
+		if (ret)
+			goto exit;
+
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_BG_EN, 0 };
 	}
-	if (ret > 5500000 || ret < 1700000)
-		return -EINVAL;
 
-	/* Check Chip ID */
-	ret = __ad7293_spi_read(st, AD7293_REG_DEVICE_ID, &chip_id);
+	seq[n++] = (struct ad7293_reg_write){ AD7293_REG_TSENSE_BG_EN, 0 };
+	seq[n++] = (struct ad7293_reg_write){ AD7293_REG_ISENSE_BG_EN, 0 };
+	seq[n++] = (struct ad7293_reg_write){
+		AD7293_REG_DAC_SNOOZE_O, snooze & AD7293_DAC_SNOOZE_MSK
+	};
+	seq[n++] = (struct ad7293_reg_write){
+		AD7293_REG_DAC_SNOOZE_1, (snooze >> 4) & AD7293_DAC_SNOOZE_MSK
+	};
+
+	ret = __ad7293_spi_write_seq(st, seq, n);
+	if (ret)
+		goto exit;
+
+	st->bg_parked = !st->dac_en;
+	st->tsense_bg = 0;
+	st->isense_bg = 0;
+
+exit:
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+/*
+ * Sensor bandgaps are brought back lazily by the first conversion that needs
+ * them, so only the reference bandgaps are waited for here.
+ */
+static int ad7293_runtime_resume(struct device *dev)
+{
+	struct ad7293_state *st = iio_priv(dev_get_drvdata(dev));
+	struct ad7293_reg_write seq[3];
+	ktime_t start = ktime_get();
+	unsigned int n = 0;
+	int ret;
+
+	mutex_lock(&st->lock);
+
+	if (st->bg_parked)
+		seq[n++] = (struct ad7293_reg_write){ AD7293_REG_BG_EN, st->bg_en };
+
+	seq[n++] = (struct ad7293_reg_write){ AD7293_REG_DAC_SNOOZE_O, 0 };
+	seq[n++] = (struct ad7293_reg_write){ AD7293_REG_DAC_SNOOZE_1, 0 };
+
+	ret = __ad7293_spi_write_seq(st, seq, n);
+	if (ret)
+		goto exit;
+
+	if (st->bg_parked)
+		fsleep(AD7293_BG_SETTLE_US);
+
+	st->bg_parked = false;
+	st->resume_cost_us = ktime_us_delta(ktime_get(), start);
+
+exit:
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+/*
+ * The supplies are turned off across system sleep, so the configuration is
+ * read back here and written again on resume.
+ */
+static int ad7293_suspend(struct device *dev)
+{
+	struct ad7293_state *st = iio_priv(dev_get_drvdata(dev));
+	unsigned int i;
+	int ret;
+
+	/* A failed resume left the device off, the snapshot is still valid */
+	if (st->supplies_off)
+		return 0;
+
+	ret = pm_runtime_force_suspend(dev);
 	if (ret)
 		return ret;
 
-	if (chip_id != AD7293_CHIP_ID) {
-		dev_err(&spi->dev, "Invalid Chip ID.\n");
-		return -EINVAL;
+	mutex_lock(&st->lock);
+
+	for (i = 0; i < ARRAY_SIZE(ad7293_ctx_regs); i++) {
+		st->ctx[i].reg = ad7293_ctx_regs[i];
+		ret = __ad7293_spi_read(st, st->ctx[i].reg, &st->ctx[i].val);
+		if (ret)
+			break;
+	}
+
+	mutex_unlock(&st->lock);
+
+	if (ret) {
+		pm_runtime_force_resume(dev);
+		return ret;
 	}
 
+	regulator_disable(st->reg_vdrive);
+	regulator_disable(st->reg_avdd);
+	st->supplies_off = true;
+
 	return 0;
 }
 
-static const struct iio_info ad7293_info = {
-	.read_raw = ad7293_read_raw,
-	.write_raw = ad7293_write_raw,
-	.read_avail = &ad7293_read_avail,
-	.debugfs_reg_access = &ad7293_reg_access,
-};
-
-static int ad7293_probe(struct spi_device *spi)
+static int ad7293_resume(struct device *dev)
 {
-	struct iio_dev *indio_dev;
-	struct ad7293_state *st;
+	struct ad7293_state *st = iio_priv(dev_get_drvdata(dev));
 	int ret;
 
-	indio_dev = devm_iio_device_alloc(&spi->dev, sizeof(*st));
-	if (!indio_dev)
-		return -ENOMEM;
-
-	st = iio_priv(indio_dev);
+	ret = regulator_enable(st->reg_avdd);
+	if (ret)
+		return ret;
 
-	indio_dev->info = &ad7293_info;
-	indio_dev->name = "ad7293";
-	indio_dev->channels = ad7293_channels;
-	indio_dev->num_channels = ARRAY_SIZE(ad7293_channels);
+	ret = regulator_enable(st->reg_vdrive);
+	if (ret) {
+		regulator_disable(st->reg_avdd);
+		return ret;
+	}
 
-	st->spi = spi;
-	st->page_select = 0;
+	mutex_lock(&st->lock);
 
-	mutex_init(&st->lock);
+	/* The page register lost its content, whatever the cache holds */
+	st->page_select = AD7293_PAGE_INVALID;
 
-	ret = ad7293_init(st);
+	ret = ad7293_reset(st);
 	if (ret)
+		goto exit;
+
+	/* Replay the whole snapshot in one SPI message */
+	ret = __ad7293_spi_write_seq(st, st->ctx, ARRAY_SIZE(st->ctx));
+	/* The sequencers came back from the snapshot, not from the cache */
+	memset(st->seq, 0xff, sizeof(st->seq));
+
+exit:
+	mutex_unlock(&st->lock);
+	if (ret) {
+		/* Leave the supplies off, as suspend did, so enables stay balanced */
+		regulator_disable(st->reg_vdrive);
+		regulator_disable(st->reg_avdd);
 		return ret;
+	}
 
-	return devm_iio_device_register(&spi->dev, indio_dev);
+	st->supplies_off = false;
+
+	return pm_runtime_force_resume(dev);
 }
 
+static const struct dev_pm_ops ad7293_pm_ops = {
+	SYSTEM_SLEEP_PM_OPS(ad7293_suspend, ad7293_resume)
+	RUNTIME_PM_OPS(ad7293_runtime_suspend, ad7293_runtime_resume, NULL)
+};
+
 static const struct spi_device_id ad7293_id[] = {
 	{ "ad7293", 0 },
 	{}
@@ -923,6 +4138,7 @@ MODULE_DEVICE_TABLE(of, ad7293_of_match);
 static struct spi_driver ad7293_driver = {
 	.driver = {
 		.name = "ad7293",
+		.pm = pm_ptr(&ad7293_pm_ops),
 		.of_match_table = ad7293_of_match,
 	},
 	.probe = ad7293_probe,
@@ -933,3 +4149,8 @@ module_spi_driver(ad7293_driver);
 MODULE_AUTHOR("Antoniu Miclaus <antoniu.miclaus@analog.com");
 MODULE_DESCRIPTION("Analog Devices AD7293");
 MODULE_LICENSE("GPL v2");
+MODULE_IMPORT_NS("IIO_DMAENGINE_BUFFER");
+
+#if IS_ENABLED(CONFIG_AD7293_KUNIT_TEST)
+#include "ad7293_kunit.c"
+#endif
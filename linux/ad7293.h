@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * AD7293 in-kernel interface
+ *
+ * Copyright 2021 Analog Devices Inc.
+ */
+
+#ifndef __AD7293_H__
+#define __AD7293_H__
+
+#include <linux/types.h>
+
+struct iio_channel;
+
+/*
+ * Return the most recent result of an AD7293 ADC channel, as obtained by the
+ * last direct read or buffered scan, without touching the bus. Safe to call
+ * from atomic context. The timestamp marks the start of the conversion, in
+ * CLOCK_MONOTONIC nanoseconds. The scale and offset of the channel do not
+ * change between samples and can be read once through
+ * iio_read_channel_scale() and iio_read_channel_offset(), or applied with
+ * iio_convert_raw_to_processed(). The offset only reflects the input coding,
+ * nonzero for differential VINx inputs: the offset trim (calibbias) is
+ * applied by the device and is already part of @raw.
+ */
+int ad7293_read_latest(struct iio_channel *chan, int *raw, s64 *timestamp);
+
+#endif /* __AD7293_H__ */
@@ -0,0 +1,728 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * AD7293 KUnit tests
+ *
+ * Built as part of the driver so that the tests reach its static functions.
+ * The driver binds to a device on a fake SPI controller that keeps a register
+ * file and counts the frames it decodes, so each test asserts the exact SPI
+ * traffic of one operation: page select writes, other writes, register reads
+ * and SPI messages.
+ *
+ * Copyright 2021 Analog Devices Inc.
+ */
+
+#include <kunit/device.h>
+#include <kunit/test.h>
+#include <linux/iio/trigger.h>
+#include <linux/regulator/driver.h>
+#include <linux/regulator/machine.h>
+
+#define AD7293_FAKE_NUM_PAGES			16
+#define AD7293_FAKE_NUM_REGS			64
+
+struct ad7293_fake {
+	u16 regs[AD7293_FAKE_NUM_PAGES][AD7293_FAKE_NUM_REGS];
+	u8 page;
+	/* Frame being clocked in: command byte, data so far and byte index */
+	u8 cmd;
+	u16 val;
+	unsigned int pos;
+	/* Traffic since the last ad7293_kunit_clear() */
+	unsigned int messages;
+	unsigned int page_selects;
+	unsigned int writes;
+	unsigned int reads;
+};
+
+struct ad7293_kunit {
+	struct ad7293_fake *fake;
+	struct spi_controller *ctlr;
+	struct iio_dev *indio_dev;
+	struct ad7293_state *st;
+	/* Traffic of a probe without any firmware configuration */
+	unsigned int probe_messages;
+	unsigned int probe_page_selects;
+	unsigned int probe_writes;
+	unsigned int probe_reads;
+};
+
+/* A chip select for the default device and one for the firmware described */
+#define AD7293_KUNIT_NUM_CS			2
+
+static const u32 ad7293_kunit_vin_offset[AD7293_NUM_VINX] = { 1, 2, 3, 4 };
+
+static const u32 ad7293_kunit_dac_default[AD7293_NUM_DAC] = {
+	0x100, 0x200, 0x300, 0x400, 0x500, 0x600, 0x700, 0x800
+};
+
+static const struct property_entry ad7293_kunit_props[] = {
+	PROPERTY_ENTRY_U32_ARRAY("adi,vin-offset", ad7293_kunit_vin_offset),
+	PROPERTY_ENTRY_U32_ARRAY("adi,dac-default", ad7293_kunit_dac_default),
+	{ }
+};
+
+static const struct software_node ad7293_kunit_node = {
+	.properties = ad7293_kunit_props,
+};
+
+/* A fixed 5 V rail, within the AVDD and VDRIVE ranges */
+static const struct regulator_ops ad7293_kunit_supply_ops = { };
+
+static const struct regulator_desc ad7293_kunit_supply_desc = {
+	.name = "ad7293-kunit-supply",
+	.type = REGULATOR_VOLTAGE,
+	.owner = THIS_MODULE,
+	.ops = &ad7293_kunit_supply_ops,
+	.n_voltages = 1,
+	.fixed_uV = 5000000,
+};
+
+static u16 *ad7293_fake_reg(struct ad7293_fake *fake, u8 addr)
+{
+	/* Common registers are the same whatever the selected page */
+	u8 page = addr < AD7293_NUM_COMMON_REGS ? 0 : fake->page;
+
+	return &fake->regs[page % AD7293_FAKE_NUM_PAGES]
+			  [addr % AD7293_FAKE_NUM_REGS];
+}
+
+/* Register width in bytes, as the device decodes it */
+static unsigned int ad7293_fake_len(const struct ad7293_fake *fake, u8 addr)
+{
+	if (addr == FIELD_GET(AD7293_REG_ADDR_MSK, AD7293_REG_PAGE_SELECT) ||
+	    addr == FIELD_GET(AD7293_REG_ADDR_MSK, AD7293_REG_RESULT) ||
+	    addr == FIELD_GET(AD7293_REG_ADDR_MSK, AD7293_REG_DAC_EN))
+		return 1;
+
+	if (addr < AD7293_NUM_COMMON_REGS)
+		return 2;
+
+	/* The offset pages hold single byte registers */
+	return fake->page >= FIELD_GET(AD7293_PAGE_ADDR_MSK,
+				       AD7293_REG_VIN0_OFFSET) ? 1 : 2;
+}
+
+static u8 ad7293_fake_xfer_byte(struct ad7293_fake *fake, u8 tx)
+{
+	unsigned int pos = fake->pos++, len;
+	u16 val;
+
+	if (!pos) {
+		fake->cmd = tx;
+		fake->val = 0;
+		return 0;
+	}
+
+	len = ad7293_fake_len(fake, fake->cmd & ~AD7293_READ);
+	if (pos > len)
+		return 0;
+
+	if (!(fake->cmd & AD7293_READ)) {
+		fake->val = fake->val << 8 | tx;
+		return 0;
+	}
+
+	val = *ad7293_fake_reg(fake, fake->cmd & ~AD7293_READ);
+
+	return len == 1 || pos == 2 ? val & 0xff : val >> 8;
+}
+
+/* Chip select deasserted: the device acts on the frame it received */
+static void ad7293_fake_frame_end(struct ad7293_fake *fake)
+{
+	u8 addr = fake->cmd & ~AD7293_READ;
+
+	if (!fake->pos)
+		return;
+
+	if (fake->cmd & AD7293_READ) {
+		fake->reads++;
+	} else {
+		*ad7293_fake_reg(fake, addr) = fake->val;
+
+		if (addr == FIELD_GET(AD7293_REG_ADDR_MSK,
+				      AD7293_REG_PAGE_SELECT)) {
+			fake->page = fake->val;
+			fake->page_selects++;
+		} else {
+			fake->writes++;
+		}
+	}
+
+	fake->pos = 0;
+}
+
+static int ad7293_fake_transfer_one_message(struct spi_controller *ctlr,
+					    struct spi_message *msg)
+{
+	struct ad7293_fake *fake = spi_controller_get_devdata(ctlr);
+	struct spi_transfer *xfer;
+	unsigned int i;
+
+	fake->messages++;
+
+	list_for_each_entry(xfer, &msg->transfers, transfer_list) {
+		const u8 *tx = xfer->tx_buf;
+		u8 *rx = xfer->rx_buf;
+
+		for (i = 0; i < xfer->len; i++) {
+			u8 out = ad7293_fake_xfer_byte(fake, tx ? tx[i] : 0);
+
+			if (rx)
+				rx[i] = out;
+		}
+
+		msg->actual_length += xfer->len;
+
+		if (xfer->cs_change)
+			ad7293_fake_frame_end(fake);
+	}
+
+	ad7293_fake_frame_end(fake);
+
+	msg->status = 0;
+	spi_finalize_current_message(ctlr);
+
+	return 0;
+}
+
+static void ad7293_fake_set(struct ad7293_fake *fake, unsigned int reg,
+			    u16 val)
+{
+	fake->regs[FIELD_GET(AD7293_PAGE_ADDR_MSK, reg)]
+		  [FIELD_GET(AD7293_REG_ADDR_MSK, reg)] = val;
+}
+
+static u16 ad7293_fake_get(const struct ad7293_fake *fake, unsigned int reg)
+{
+	return fake->regs[FIELD_GET(AD7293_PAGE_ADDR_MSK, reg)]
+			 [FIELD_GET(AD7293_REG_ADDR_MSK, reg)];
+}
+
+static void ad7293_kunit_clear(struct ad7293_kunit *priv)
+{
+	priv->fake->messages = 0;
+	priv->fake->page_selects = 0;
+	priv->fake->writes = 0;
+	priv->fake->reads = 0;
+	priv->st->page_switches = 0;
+	priv->st->reg_reads = 0;
+}
+
+static const struct iio_chan_spec *
+ad7293_kunit_chan(enum iio_chan_type type, int channel, bool output)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(ad7293_channels); i++) {
+		if (ad7293_channels[i].type == type &&
+		    ad7293_channels[i].channel == channel &&
+		    ad7293_channels[i].output == output)
+			return &ad7293_channels[i];
+	}
+
+	return NULL;
+}
+
+static int ad7293_kunit_read(struct ad7293_kunit *priv,
+			     const struct iio_chan_spec *chan, long info,
+			     int *val)
+{
+	int val2;
+
+	return priv->indio_dev->info->read_raw(priv->indio_dev, chan, val,
+					       &val2, info);
+}
+
+static int ad7293_kunit_write(struct ad7293_kunit *priv,
+			      const struct iio_chan_spec *chan, long info,
+			      int val)
+{
+	return priv->indio_dev->info->write_raw(priv->indio_dev, chan, val, 0,
+						info);
+}
+
+KUNIT_DEFINE_ACTION_WRAPPER(ad7293_kunit_spi_unregister, spi_unregister_device,
+			    struct spi_device *);
+KUNIT_DEFINE_ACTION_WRAPPER(ad7293_kunit_pm_put, pm_runtime_put_noidle,
+			    struct device *);
+
+static void ad7293_kunit_trig_reset(void *data)
+{
+	struct iio_dev *indio_dev = data;
+
+	/* The core would drop a reference on the fake trigger otherwise */
+	indio_dev->trig = NULL;
+	indio_dev->active_scan_mask = NULL;
+}
+
+/*
+ * Add a device on @cs and let the driver probe it. The device is kept
+ * resumed, so autosuspend traffic never shows up in the counts.
+ */
+static struct iio_dev *ad7293_kunit_bind(struct kunit *test,
+					 struct spi_controller *ctlr, u8 cs,
+					 const struct software_node *swnode)
+{
+	struct spi_board_info info = {
+		.modalias = "ad7293",
+		.max_speed_hz = AD7293_SPI_WRITE_MAX_HZ,
+		.chip_select = cs,
+		.swnode = swnode,
+	};
+	struct iio_dev *indio_dev;
+	struct spi_device *spi;
+	int ret;
+
+	spi = spi_new_device(ctlr, &info);
+	KUNIT_ASSERT_NOT_NULL(test, spi);
+
+	ret = kunit_add_action_or_reset(test, ad7293_kunit_spi_unregister, spi);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	indio_dev = spi_get_drvdata(spi);
+	KUNIT_ASSERT_NOT_NULL(test, indio_dev);
+
+	ret = pm_runtime_resume_and_get(&spi->dev);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	ret = kunit_add_action_or_reset(test, ad7293_kunit_pm_put, &spi->dev);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	return indio_dev;
+}
+
+static int ad7293_kunit_init(struct kunit *test)
+{
+	struct regulator_config config = { };
+	struct regulator_consumer_supply *supplies;
+	struct regulator_init_data *init_data;
+	struct regulator_dev *rdev;
+	struct spi_controller *ctlr;
+	struct ad7293_kunit *priv;
+	struct device *dev;
+	unsigned int cs;
+	int ret;
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv);
+
+	dev = kunit_device_register(test, "ad7293-kunit");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+
+	ctlr = devm_spi_alloc_host(dev, sizeof(*priv->fake));
+	KUNIT_ASSERT_NOT_NULL(test, ctlr);
+
+	ctlr->bus_num = -1;
+	ctlr->num_chipselect = AD7293_KUNIT_NUM_CS;
+	ctlr->max_speed_hz = AD7293_SPI_WRITE_MAX_HZ;
+	ctlr->transfer_one_message = ad7293_fake_transfer_one_message;
+
+	ret = devm_spi_register_controller(dev, ctlr);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	/* Both supplies of every chip select, named after the SPI devices */
+	supplies = kunit_kcalloc(test, 2 * AD7293_KUNIT_NUM_CS,
+				 sizeof(*supplies), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, supplies);
+
+	for (cs = 0; cs < AD7293_KUNIT_NUM_CS; cs++) {
+		const char *name = kunit_kasprintf(test, GFP_KERNEL, "%s.%u",
+						   dev_name(&ctlr->dev), cs);
+
+		KUNIT_ASSERT_NOT_NULL(test, name);
+
+		supplies[2 * cs] = (struct regulator_consumer_supply)
+			REGULATOR_SUPPLY("avdd", name);
+		supplies[2 * cs + 1] = (struct regulator_consumer_supply)
+			REGULATOR_SUPPLY("vdrive", name);
+	}
+
+	init_data = kunit_kzalloc(test, sizeof(*init_data), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, init_data);
+
+	init_data->consumer_supplies = supplies;
+	init_data->num_consumer_supplies = 2 * AD7293_KUNIT_NUM_CS;
+
+	config.dev = dev;
+	config.init_data = init_data;
+
+	rdev = devm_regulator_register(dev, &ad7293_kunit_supply_desc, &config);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rdev);
+
+	priv->ctlr = ctlr;
+	priv->fake = spi_controller_get_devdata(ctlr);
+	ad7293_fake_set(priv->fake, AD7293_REG_DEVICE_ID, AD7293_CHIP_ID);
+
+	priv->indio_dev = ad7293_kunit_bind(test, ctlr, 0, NULL);
+	priv->st = iio_priv(priv->indio_dev);
+
+	priv->probe_messages = priv->fake->messages;
+	priv->probe_page_selects = priv->fake->page_selects;
+	priv->probe_writes = priv->fake->writes;
+	priv->probe_reads = priv->fake->reads;
+
+	ad7293_fake_set(priv->fake, AD7293_REG_VIN0, 0x1230);
+	ad7293_fake_set(priv->fake, AD7293_REG_VIN1, 0x4560);
+	ad7293_fake_set(priv->fake, AD7293_REG_VIN0_OFFSET, 0x05);
+	ad7293_fake_set(priv->fake, AD7293_REG_UNI_VOUT0, 0x8000);
+	ad7293_kunit_clear(priv);
+
+	test->priv = priv;
+
+	return 0;
+}
+
+static void ad7293_test_read_cached(struct kunit *test)
+{
+	const struct iio_chan_spec *vin0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     false);
+	struct ad7293_kunit *priv = test->priv;
+	struct ad7293_fake *fake = priv->fake;
+	int val;
+
+	KUNIT_ASSERT_NOT_NULL(test, vin0);
+
+	/* Sequencer on page 0x3, then conversion and result on page 0x0 */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_read(priv, vin0, IIO_CHAN_INFO_RAW,
+						&val), IIO_VAL_INT);
+	KUNIT_EXPECT_EQ(test, val, 0x123);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 2);
+	KUNIT_EXPECT_EQ(test, fake->writes, 2);
+	KUNIT_EXPECT_EQ(test, fake->reads, 1);
+	KUNIT_EXPECT_EQ(test, fake->messages, 4);
+
+	ad7293_kunit_clear(priv);
+
+	/* Page and sequencer cached: only the conversion and the result */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_read(priv, vin0, IIO_CHAN_INFO_RAW,
+						&val), IIO_VAL_INT);
+	KUNIT_EXPECT_EQ(test, val, 0x123);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 0);
+	KUNIT_EXPECT_EQ(test, fake->writes, 1);
+	KUNIT_EXPECT_EQ(test, fake->reads, 1);
+	KUNIT_EXPECT_EQ(test, fake->messages, 2);
+
+	/* The debugfs counters agree with the bus */
+	KUNIT_EXPECT_EQ(test, priv->st->page_switches, fake->page_selects);
+	KUNIT_EXPECT_EQ(test, priv->st->reg_reads, fake->reads);
+}
+
+static void ad7293_test_read_cross_page(struct kunit *test)
+{
+	const struct iio_chan_spec *vin0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     false);
+	const struct iio_chan_spec *dac0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     true);
+	struct ad7293_kunit *priv = test->priv;
+	struct ad7293_fake *fake = priv->fake;
+	int val;
+
+	KUNIT_ASSERT_NOT_NULL(test, vin0);
+	KUNIT_ASSERT_NOT_NULL(test, dac0);
+
+	/* Leave page 0x0 selected */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_read(priv, vin0, IIO_CHAN_INFO_RAW,
+						&val), IIO_VAL_INT);
+	ad7293_kunit_clear(priv);
+
+	/* Offset trims live on page 0xE: one page select, one read */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_read(priv, vin0,
+						IIO_CHAN_INFO_CALIBBIAS, &val),
+			IIO_VAL_INT);
+	KUNIT_EXPECT_EQ(test, val, 0x05);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 1);
+	KUNIT_EXPECT_EQ(test, fake->writes, 0);
+	KUNIT_EXPECT_EQ(test, fake->reads, 1);
+	KUNIT_EXPECT_EQ(test, fake->messages, 2);
+
+	ad7293_kunit_clear(priv);
+
+	/* And back to page 0x0 for a DAC code, without any conversion */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_read(priv, dac0, IIO_CHAN_INFO_RAW,
+						&val), IIO_VAL_INT);
+	KUNIT_EXPECT_EQ(test, val, 0x800);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 1);
+	KUNIT_EXPECT_EQ(test, fake->writes, 0);
+	KUNIT_EXPECT_EQ(test, fake->reads, 1);
+	KUNIT_EXPECT_EQ(test, fake->messages, 2);
+
+	KUNIT_EXPECT_EQ(test, priv->st->page_switches, fake->page_selects);
+	KUNIT_EXPECT_EQ(test, priv->st->reg_reads, fake->reads);
+}
+
+static void ad7293_test_scan(struct kunit *test)
+{
+	struct ad7293_kunit *priv = test->priv;
+	struct iio_poll_func pf = { .indio_dev = priv->indio_dev };
+	struct ad7293_fake *fake = priv->fake;
+	struct ad7293_state *st = priv->st;
+	unsigned long mask = BIT(0) | BIT(1);
+	struct iio_trigger *trig;
+
+	trig = kunit_kzalloc(test, sizeof(*trig), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, trig);
+
+	KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test,
+							ad7293_kunit_trig_reset,
+							priv->indio_dev), 0);
+
+	priv->indio_dev->trig = trig;
+	priv->indio_dev->active_scan_mask = &mask;
+
+	/* The sequencer is programmed once for the whole capture */
+	KUNIT_ASSERT_EQ(test, ad7293_update_scan_mode(priv->indio_dev, &mask),
+			0);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 1);
+	KUNIT_EXPECT_EQ(test, fake->writes, 1);
+	KUNIT_EXPECT_EQ(test, fake->reads, 0);
+
+	ad7293_kunit_clear(priv);
+
+	/* Back to the result page, then one message for the whole scan */
+	ad7293_trigger_handler(0, &pf);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(st->scan.channels[0]), 0x1230);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(st->scan.channels[1]), 0x4560);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 1);
+	KUNIT_EXPECT_EQ(test, fake->writes, 1);
+	KUNIT_EXPECT_EQ(test, fake->reads, 2);
+	KUNIT_EXPECT_EQ(test, fake->messages, 2);
+
+	ad7293_kunit_clear(priv);
+
+	/* Steady state: the scan message alone */
+	ad7293_trigger_handler(0, &pf);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 0);
+	KUNIT_EXPECT_EQ(test, fake->writes, 1);
+	KUNIT_EXPECT_EQ(test, fake->reads, 2);
+	KUNIT_EXPECT_EQ(test, fake->messages, 1);
+}
+
+static void ad7293_test_dac_write(struct kunit *test)
+{
+	const struct iio_chan_spec *dac0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     true);
+	struct ad7293_kunit *priv = test->priv;
+	struct ad7293_fake *fake = priv->fake;
+
+	KUNIT_ASSERT_NOT_NULL(test, dac0);
+
+	/* Enable read-modify-write on page 0x0, then the code itself */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_write(priv, dac0, IIO_CHAN_INFO_RAW,
+						 0x400), 0);
+	KUNIT_EXPECT_EQ(test, ad7293_fake_get(fake, AD7293_REG_UNI_VOUT0),
+			0x4000);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 1);
+	KUNIT_EXPECT_EQ(test, fake->writes, 2);
+	KUNIT_EXPECT_EQ(test, fake->reads, 1);
+	KUNIT_EXPECT_EQ(test, fake->messages, 4);
+
+	ad7293_kunit_clear(priv);
+
+	/* Same page: no page select */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_write(priv, dac0, IIO_CHAN_INFO_RAW,
+						 0x401), 0);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 0);
+	KUNIT_EXPECT_EQ(test, fake->writes, 2);
+	KUNIT_EXPECT_EQ(test, fake->reads, 1);
+	KUNIT_EXPECT_EQ(test, fake->messages, 3);
+}
+
+static void ad7293_test_offset_write(struct kunit *test)
+{
+	const struct iio_chan_spec *vin0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     false);
+	struct ad7293_kunit *priv = test->priv;
+	struct ad7293_fake *fake = priv->fake;
+
+	KUNIT_ASSERT_NOT_NULL(test, vin0);
+
+	/* Whole register write on page 0xE, in two's complement */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_write(priv, vin0,
+						 IIO_CHAN_INFO_CALIBBIAS, -3),
+			0);
+	KUNIT_EXPECT_EQ(test, ad7293_fake_get(fake, AD7293_REG_VIN0_OFFSET),
+			0xfd);
+	KUNIT_EXPECT_EQ(test, fake->page_selects, 1);
+	KUNIT_EXPECT_EQ(test, fake->writes, 1);
+	KUNIT_EXPECT_EQ(test, fake->reads, 0);
+	KUNIT_EXPECT_EQ(test, fake->messages, 2);
+
+	ad7293_kunit_clear(priv);
+
+	/* Out of range trims never reach the bus */
+	KUNIT_EXPECT_EQ(test, ad7293_kunit_write(priv, vin0,
+						 IIO_CHAN_INFO_CALIBBIAS, 128),
+			-EINVAL);
+	KUNIT_EXPECT_EQ(test, fake->messages, 0);
+}
+
+static void ad7293_test_scale_read(struct kunit *test)
+{
+	const struct iio_chan_spec *vin0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     false);
+	const struct iio_chan_spec *isense0 = ad7293_kunit_chan(IIO_CURRENT, 0,
+								false);
+	struct ad7293_kunit *priv = test->priv;
+	struct ad7293_fake *fake = priv->fake;
+	int val;
+
+	KUNIT_ASSERT_NOT_NULL(test, vin0);
+	KUNIT_ASSERT_NOT_NULL(test, isense0);
+
+	/* Scales are served from the cached ranges and gains */
+	KUNIT_EXPECT_EQ(test, ad7293_kunit_read(priv, vin0,
+						IIO_CHAN_INFO_SCALE, &val),
+			IIO_VAL_INT_PLUS_NANO);
+	KUNIT_EXPECT_EQ(test, ad7293_kunit_read(priv, isense0,
+						IIO_CHAN_INFO_SCALE, &val),
+			IIO_VAL_INT_PLUS_NANO);
+	KUNIT_EXPECT_EQ(test, fake->messages, 0);
+}
+
+static void ad7293_test_probe_burst(struct kunit *test)
+{
+	struct ad7293_kunit *priv = test->priv;
+	struct ad7293_fake *fake = priv->fake;
+	unsigned int i;
+
+	/*
+	 * Same probe as the default device plus the firmware configuration:
+	 * one message with the offsets on page 0xE, then the DAC codes and
+	 * their enable on page 0x0.
+	 */
+	ad7293_kunit_bind(test, priv->ctlr, 1, &ad7293_kunit_node);
+	KUNIT_EXPECT_EQ(test, fake->page_selects - priv->probe_page_selects, 2);
+	KUNIT_EXPECT_EQ(test, fake->writes - priv->probe_writes,
+			AD7293_NUM_VINX + AD7293_NUM_DAC + 1);
+	KUNIT_EXPECT_EQ(test, fake->reads, priv->probe_reads);
+	KUNIT_EXPECT_EQ(test, fake->messages - priv->probe_messages, 1);
+
+	for (i = 0; i < AD7293_NUM_VINX; i++)
+		KUNIT_EXPECT_EQ(test,
+				ad7293_fake_get(fake, AD7293_REG_VIN0_OFFSET + i),
+				ad7293_kunit_vin_offset[i]);
+
+	KUNIT_EXPECT_EQ(test, ad7293_fake_get(fake, AD7293_REG_DAC_EN),
+			GENMASK(AD7293_NUM_DAC - 1, 0));
+}
+
+/* Processed value of @chan for @raw, as an in-kernel consumer computes it */
+static int ad7293_kunit_processed(struct ad7293_kunit *priv,
+				  const struct iio_chan_spec *chan, int raw)
+{
+	struct iio_channel channel = {
+		.indio_dev = priv->indio_dev,
+		.channel = chan,
+	};
+	int val;
+
+	if (iio_convert_raw_to_processed(&channel, raw, &val, 1))
+		return INT_MIN;
+
+	return val;
+}
+
+static void ad7293_test_trim_processed(struct kunit *test)
+{
+	const struct iio_chan_spec *vin0 = ad7293_kunit_chan(IIO_VOLTAGE, 0,
+							     false);
+	const struct iio_chan_spec *isense0 = ad7293_kunit_chan(IIO_CURRENT, 0,
+								false);
+	const struct iio_chan_spec *temp0 = ad7293_kunit_chan(IIO_TEMP, 0,
+							      false);
+	struct ad7293_kunit *priv = test->priv;
+	int vin, isense, temp;
+
+	KUNIT_ASSERT_NOT_NULL(test, vin0);
+	KUNIT_ASSERT_NOT_NULL(test, isense0);
+	KUNIT_ASSERT_NOT_NULL(test, temp0);
+
+	vin = ad7293_kunit_processed(priv, vin0, 0x123);
+	isense = ad7293_kunit_processed(priv, isense0, 0x123);
+	temp = ad7293_kunit_processed(priv, temp0, 0x123);
+	KUNIT_ASSERT_NE(test, vin, INT_MIN);
+	KUNIT_ASSERT_NE(test, isense, INT_MIN);
+	KUNIT_ASSERT_NE(test, temp, INT_MIN);
+
+	/* The device applies the trim to the code, the host must not again */
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_write(priv, vin0,
+						 IIO_CHAN_INFO_CALIBBIAS, 5),
+			0);
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_write(priv, isense0,
+						 IIO_CHAN_INFO_CALIBBIAS, -7),
+			0);
+	KUNIT_ASSERT_EQ(test, ad7293_kunit_write(priv, temp0,
+						 IIO_CHAN_INFO_CALIBBIAS, 9),
+			0);
+
+	KUNIT_EXPECT_EQ(test, ad7293_kunit_processed(priv, vin0, 0x123), vin);
+	KUNIT_EXPECT_EQ(test, ad7293_kunit_processed(priv, isense0, 0x123),
+			isense);
+	KUNIT_EXPECT_EQ(test, ad7293_kunit_processed(priv, temp0, 0x123),
+			temp);
+}
+
+static void ad7293_test_ch_table(struct kunit *test)
+{
+	const struct ad7293_ch_desc *desc;
+	unsigned int i, j;
+
+	/* Every offset register of the table is carried by the blob */
+	KUNIT_EXPECT_EQ(test, ARRAY_SIZE(ad7293_offset_regs), AD7293_NUM_CH);
+	for (i = 0; i < AD7293_NUM_CH; i++) {
+		desc = &ad7293_ch_descs[i];
+
+		for (j = 0; j < ARRAY_SIZE(ad7293_offset_regs); j++) {
+			if (ad7293_offset_regs[j] == ad7293_ch_offset(desc))
+				break;
+		}
+		KUNIT_EXPECT_LT_MSG(test, j, ARRAY_SIZE(ad7293_offset_regs),
+				    "%s", desc->name);
+
+		if (i < AD7293_NUM_ADC_CH)
+			KUNIT_EXPECT_LT(test, ad7293_seq_idx(desc),
+					ARRAY_SIZE(ad7293_seq_regs));
+	}
+
+	/* Window registers of a page 0 and of a page 1 channel */
+	desc = &ad7293_ch_descs[AD7293_CH_VIN0];
+	KUNIT_EXPECT_EQ(test, ad7293_ch_limit(desc, AD7293_LIMIT_HIGH),
+			AD7293_R2B | AD7293_PAGE(0x4) | 0x10);
+	KUNIT_EXPECT_EQ(test, ad7293_ch_limit(desc, AD7293_LIMIT_MAX),
+			AD7293_R2B | AD7293_PAGE(0xC) | 0x10);
+
+	desc = &ad7293_ch_descs[AD7293_CH_RS_MON0 + 3];
+	KUNIT_EXPECT_EQ(test, ad7293_ch_offset(desc),
+			AD7293_REG_RS3_MON_OFFSET);
+	KUNIT_EXPECT_EQ(test, ad7293_ch_limit(desc, AD7293_LIMIT_LOW),
+			AD7293_R2B | AD7293_PAGE(0x7) | 0x2B);
+	KUNIT_EXPECT_EQ(test, ad7293_ch_limit(desc, AD7293_LIMIT_HYST),
+			AD7293_R2B | AD7293_PAGE(0x9) | 0x2B);
+	KUNIT_EXPECT_EQ(test, ad7293_ch_limit(desc, AD7293_LIMIT_MIN),
+			AD7293_R2B | AD7293_PAGE(0xB) | 0x2B);
+
+	KUNIT_EXPECT_FALSE(test, ad7293_ch_has_limits(ad7293_dac_desc(0)));
+	KUNIT_EXPECT_EQ(test, ad7293_ch_result(ad7293_dac_desc(7)),
+			AD7293_REG_BI_VOUT3);
+}
+
+static struct kunit_case ad7293_test_cases[] = {
+	KUNIT_CASE(ad7293_test_read_cached),
+	KUNIT_CASE(ad7293_test_read_cross_page),
+	KUNIT_CASE(ad7293_test_scan),
+	KUNIT_CASE(ad7293_test_dac_write),
+	KUNIT_CASE(ad7293_test_offset_write),
+	KUNIT_CASE(ad7293_test_scale_read),
+	KUNIT_CASE(ad7293_test_probe_burst),
+	KUNIT_CASE(ad7293_test_trim_processed),
+	KUNIT_CASE(ad7293_test_ch_table),
+	{ }
+};
+
+static struct kunit_suite ad7293_test_suite = {
+	.name = "ad7293",
+	.init = ad7293_kunit_init,
+	.test_cases = ad7293_test_cases,
+};
+kunit_test_suite(ad7293_test_suite);
@@ -45,378 +45,2035 @@
 #include "no_os_error.h"
 #include "no_os_delay.h"
 
+/******************************************************************************/
+/************************* Variable Declarations ******************************/
+/******************************************************************************/
+
+/* ISENSE amplifier gain in V/V x 100, indexed by gain code */
+static const uint16_t ad7293_isense_gain_table[] = {
+	100, 200, 400, 625, 800, 1250, 1600, 2500, 3200, 5000, 10000
+};
+
+/* VINx full scale range in mV, indexed by range code */
+static const uint16_t ad7293_adc_range_table[] = {
+	4 * AD7293_REFADC_MV, 2 * AD7293_REFADC_MV, AD7293_REFADC_MV,
+	AD7293_REFADC_MV / 2
+};
+
+/* Delay inserted between two sequenced conversions, in microseconds */
+static const uint16_t ad7293_conv_delay_table[] = {
+	0, 2, 4, 8, 16, 32, 64, 128
+};
+
 /******************************************************************************/
 /************************** Functions Implementation **************************/
 /******************************************************************************/
 
 /**
- * @brief Set specific AD7293 page.
+ * @brief Look up the descriptor of a channel.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @return The channel descriptor, or NULL for an invalid channel.
+ */
+static const struct ad7293_ch_desc *ad7293_ch_desc(enum ad7293_ch_type type,
+		unsigned int ch)
+{
+	if (ch >= ad7293_ch_num(type))
+		return NULL;
+
+	return &ad7293_ch_descs[ad7293_ch_index(type, ch)];
+}
+
+/**
+ * @brief Take the device lock, if one was provided at initialization.
+ * @param dev - The device structure.
+ */
+static void ad7293_lock(struct ad7293_dev *dev)
+{
+	if (dev->lock)
+		dev->lock(dev->lock_ctx);
+}
+
+/**
+ * @brief Release the device lock, if one was provided at initialization.
+ * @param dev - The device structure.
+ */
+static void ad7293_unlock(struct ad7293_dev *dev)
+{
+	if (dev->unlock)
+		dev->unlock(dev->lock_ctx);
+}
+
+/**
+ * @brief Set specific AD7293 page.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+static int ad7293_page_select(struct ad7293_dev *dev, unsigned int reg)
+{
+	uint8_t data[2];
+	unsigned int len;
+	int ret;
+
+	len = ad7293_frame_page(data, dev->page_select, reg);
+	if (len) {
+		ret = no_os_spi_write_and_read(dev->spi_desc, data, len);
+		if (ret) {
+			/* The page may or may not have been latched */
+			dev->page_select = AD7293_PAGE_INVALID;
+			return ret;
+		}
+
+		dev->page_select = ad7293_reg_page(reg);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Reads data from AD7293 over SPI, the device lock being held.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data read from the device.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+static int __ad7293_spi_read(struct ad7293_dev *dev, unsigned int reg,
+			     uint16_t *val)
+{
+	uint8_t buff[AD7293_BUFF_SIZE_BYTES];
+	int ret;
+
+	ret = ad7293_page_select(dev, reg);
+	if (ret)
+		return ret;
+
+	ret = no_os_spi_write_and_read(dev->spi_desc, buff,
+				       ad7293_frame_read(buff, reg));
+	if (ret) {
+		dev->page_select = AD7293_PAGE_INVALID;
+		return ret;
+	}
+
+	*val = ad7293_frame_val(buff, reg);
+
+	return 0;
+}
+
+/**
+ * @brief Reads data from AD7293 over SPI.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data read from the device.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+int ad7293_spi_read(struct ad7293_dev *dev, unsigned int reg, uint16_t *val)
+{
+	int ret;
+
+	ad7293_lock(dev);
+	ret = __ad7293_spi_read(dev, reg, val);
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Writes data to AD7293 over SPI, the device lock being held.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data value to write.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+static int __ad7293_spi_write(struct ad7293_dev *dev, unsigned int reg,
+			      uint16_t val)
+{
+	uint8_t buff[AD7293_BUFF_SIZE_BYTES];
+	int ret;
+
+	ret = ad7293_page_select(dev, reg);
+	if (ret)
+		return ret;
+
+	ret = no_os_spi_write_and_read(dev->spi_desc, buff,
+				       ad7293_frame_write(buff, reg, val));
+
+	/*
+	 * A failed transfer, a raw page select or a reset all leave the page
+	 * register out of sync with the cached value.
+	 */
+	if (ret || reg == AD7293_REG_PAGE_SELECT || reg == AD7293_REG_SOFT_RESET)
+		dev->page_select = AD7293_PAGE_INVALID;
+
+	return ret;
+}
+
+/**
+ * @brief Writes data to AD7293 over SPI.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data value to write.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+int ad7293_spi_write(struct ad7293_dev *dev, unsigned int reg, uint16_t val)
+{
+	int ret;
+
+	ad7293_lock(dev);
+	ret = __ad7293_spi_write(dev, reg, val);
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Write data to AD7293 and read it back within the same SPI message,
+ *	  the device lock being held.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data value to write.
+ * @return Returns 0 in case of success, -EIO if the register did not take the
+ *	   value or negative error code otherwise.
+ */
+static int __ad7293_spi_write_verify(struct ad7293_dev *dev, unsigned int reg,
+				     uint16_t val)
+{
+	uint8_t tx[AD7293_BUFF_SIZE_BYTES], rx[AD7293_BUFF_SIZE_BYTES];
+	struct no_os_spi_msg msgs[2] = {0};
+	int ret;
+
+	ret = ad7293_page_select(dev, reg);
+	if (ret)
+		return ret;
+
+	msgs[0].tx_buff = tx;
+	msgs[0].bytes_number = ad7293_frame_write(tx, reg, val);
+	msgs[0].cs_change = 1;
+	msgs[1].tx_buff = rx;
+	msgs[1].rx_buff = rx;
+	msgs[1].bytes_number = ad7293_frame_read(rx, reg);
+	msgs[1].cs_change = 1;
+
+	ret = no_os_spi_transfer(dev->spi_desc, msgs, NO_OS_ARRAY_SIZE(msgs));
+	if (ret) {
+		dev->page_select = AD7293_PAGE_INVALID;
+		return ret;
+	}
+
+	if (ad7293_frame_val(rx, reg) != val) {
+		dev->verify_fail++;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write data to AD7293 and read it back within the same SPI message.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data value to write.
+ * @return Returns 0 in case of success, -EIO if the register did not take the
+ *	   value or negative error code otherwise.
+ */
+int ad7293_spi_write_verify(struct ad7293_dev *dev, unsigned int reg,
+			    uint16_t val)
+{
+	int ret;
+
+	ad7293_lock(dev);
+	ret = __ad7293_spi_write_verify(dev, reg, val);
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Write a DAC setting, verified if requested at initialization.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param val - Data value to write.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+static int __ad7293_dac_write(struct ad7293_dev *dev, unsigned int reg,
+			      uint16_t val)
+{
+	if (dev->verify_writes)
+		return __ad7293_spi_write_verify(dev, reg, val);
+
+	return __ad7293_spi_write(dev, reg, val);
+}
+
+/**
+ * @brief Check the page register against the cached page.
+ * @param dev - The device structure.
+ * @return Returns 0 if the cache matched, -EIO if it did not or negative
+ *	   error code otherwise. In both cases the cache is resynchronized with
+ *	   the page actually selected in the device.
+ */
+int ad7293_page_verify(struct ad7293_dev *dev)
+{
+	uint8_t data[2];
+	int ret;
+
+	/* PAGE_SELECT is reachable from any page, so no selection is needed */
+	ad7293_lock(dev);
+
+	ret = no_os_spi_write_and_read(dev->spi_desc, data,
+				       ad7293_frame_read(data,
+						       AD7293_REG_PAGE_SELECT));
+	if (ret) {
+		dev->page_select = AD7293_PAGE_INVALID;
+		goto unlock;
+	}
+
+	if (dev->page_select != AD7293_PAGE_INVALID &&
+	    dev->page_select != data[1]) {
+		dev->page_mismatch++;
+		ret = -EIO;
+	}
+
+	dev->page_select = data[1];
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Update AD7293 register, the device lock being held.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param mask - Mask for specific register bits to be updated.
+ * @param val - Data written to the device (requires prior bit shifting).
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+static int __ad7293_spi_update_bits(struct ad7293_dev *dev, unsigned int reg,
+				    uint16_t mask, uint16_t val)
+{
+	int ret;
+	uint16_t data, temp;
+
+	ret = __ad7293_spi_read(dev, reg, &data);
+	if (ret)
+		return ret;
+
+	temp = (data & ~mask) | (val & mask);
+
+	return __ad7293_spi_write(dev, reg, temp);
+}
+
+/**
+ * @brief Update AD7293 register.
+ * @param dev - The device structure.
+ * @param reg - The register address.
+ * @param mask - Mask for specific register bits to be updated.
+ * @param val - Data written to the device (requires prior bit shifting).
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+int ad7293_spi_update_bits(struct ad7293_dev *dev, unsigned int reg,
+			   uint16_t mask, uint16_t val)
+{
+	int ret;
+
+	ad7293_lock(dev);
+	ret = __ad7293_spi_update_bits(dev, reg, mask, val);
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Get the range value for ADC channels.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param range - the range value.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_adc_get_range(struct ad7293_dev *dev, unsigned int ch,
+			 uint16_t *range)
+{
+	int ret;
+	uint16_t data;
+
+	ret = ad7293_spi_read(dev, AD7293_REG_VINX_RANGE1, &data);
+	if (ret)
+		return ret;
+
+	*range = AD7293_REG_VINX_RANGE_GET_CH_MSK(data, ch);
+
+	ret = ad7293_spi_read(dev, AD7293_REG_VINX_RANGE0, &data);
+	if (ret)
+		return ret;
+
+	*range |= AD7293_REG_VINX_RANGE_GET_CH_MSK(data, ch) << 1;
+
+	return 0;
+}
+
+/**
+ * @brief Set the range value for ADC channels.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param range - the range value.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_adc_set_range(struct ad7293_dev *dev, unsigned int ch,
+			 uint16_t range)
+{
+	int ret;
+	unsigned int ch_msk = NO_OS_BIT(ch);
+
+	if (ch >= AD7293_NUM_VINX ||
+	    range >= NO_OS_ARRAY_SIZE(ad7293_adc_range_table))
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_update_bits(dev, AD7293_REG_VINX_RANGE1, ch_msk,
+				       AD7293_REG_VINX_RANGE_SET_CH_MSK(range, ch));
+	if (ret)
+		goto unlock;
+
+	ret = __ad7293_spi_update_bits(dev, AD7293_REG_VINX_RANGE0, ch_msk,
+				       AD7293_REG_VINX_RANGE_SET_CH_MSK((range >> 1), ch));
+	if (ret)
+		goto unlock;
+
+	dev->vin_range[ch] = range;
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Set the gain value for ISENSE channels.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param gain - the range value.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_isense_set_gain(struct ad7293_dev *dev, unsigned int ch,
+			   uint16_t gain)
+{
+	unsigned int ch_msk = (0xf << (4 * ch));
+	int ret;
+
+	if (ch >= AD7293_NUM_ISENSE ||
+	    gain >= NO_OS_ARRAY_SIZE(ad7293_isense_gain_table))
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_update_bits(dev, AD7293_REG_ISENSE_GAIN, ch_msk,
+				       gain << (4 * ch));
+	if (!ret)
+		dev->isense_gain[ch] = gain;
+
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Get the gain value for ISENSE channels.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param gain - the gain read.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_isense_get_gain(struct ad7293_dev *dev, unsigned int ch,
+			   uint16_t *gain)
+{
+	int ret;
+
+	ret = ad7293_spi_read(dev, AD7293_REG_ISENSE_GAIN, gain);
+	if (ret)
+		return ret;
+
+	*gain = (*gain >> (4 * ch)) & 0xf;
+
+	return 0;
+}
+
+/**
+ * @brief Get the scale of a channel from the cached range and gain settings.
+ *
+ * VINx scales are in mV, ISENSE scales in mA and TSENSE scales in milli
+ * degrees Celsius per LSB.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param scale - the scale in engineering units per LSB.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_get_scale(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		     unsigned int ch, float *scale)
+{
+	float full_scale;
+
+	switch (type) {
+	case AD7293_ADC_VINX:
+		if (ch >= AD7293_NUM_VINX)
+			return -EINVAL;
+
+		full_scale = ad7293_adc_range_table[dev->vin_range[ch]];
+
+		break;
+	case AD7293_ADC_ISENSE:
+		if (ch >= AD7293_NUM_ISENSE)
+			return -EINVAL;
+
+		/* mV across the shunt, then mA through it */
+		full_scale = AD7293_REFADC_MV * 100.0f /
+			     ad7293_isense_gain_table[dev->isense_gain[ch]];
+		full_scale = full_scale * 1000000.0f / dev->isense_shunt_uohm[ch];
+
+		break;
+	case AD7293_ADC_TSENSE:
+		if (ch >= AD7293_NUM_TSENSE)
+			return -EINVAL;
+
+		*scale = AD7293_TSENSE_SCALE_MILLI_C;
+
+		return 0;
+	default:
+		return -EINVAL;
+	}
+
+	*scale = full_scale / NO_OS_BIT(AD7293_ADC_RESOLUTION);
+
+	return 0;
+}
+
+/**
+ * @brief Compute the per channel coefficients used to convert scan frames.
+ *
+ * The coefficients only need to be recomputed when a range or gain changes.
+ * @param dev - The device structure.
+ * @param chans - the channels of a frame, in frame order.
+ * @param num_chans - the number of channels in a frame.
+ * @param coeffs - the coefficients, one per channel.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_frame_scale_init(struct ad7293_dev *dev,
+			    const struct ad7293_chan_id *chans,
+			    unsigned int num_chans, float *coeffs)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < num_chans; i++) {
+		ret = ad7293_get_scale(dev, chans[i].type, chans[i].ch,
+				       &coeffs[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Convert raw scan frames to engineering units.
+ *
+ * The loop carries no dependency between samples and has no branches, so
+ * the compiler is free to vectorise it.
+ * @param coeffs - the coefficients computed by ad7293_frame_scale_init().
+ * @param raw - the raw frames, num_frames consecutive frames of num_chans codes.
+ * @param out - the converted frames, same layout as raw.
+ * @param num_chans - the number of channels in a frame.
+ * @param num_frames - the number of frames.
+ */
+void ad7293_frame_to_units(const float *coeffs, const uint16_t *raw,
+			   float *out, unsigned int num_chans,
+			   unsigned int num_frames)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < num_frames; i++) {
+		for (j = 0; j < num_chans; j++)
+			out[j] = raw[j] * coeffs[j];
+
+		raw += num_chans;
+		out += num_chans;
+	}
+}
+
+/**
+ * @brief Pack raw codes two in three bytes for storage.
+ *
+ * Codes a and b become a[11:4], a[3:0] b[11:8], b[7:0], so a packed stream
+ * reads in the same bit order as the result registers. With an odd number
+ * of codes, the last one takes two bytes, its low nibble padded with zeros.
+ * Frames are packed back to back, the layout only depending on the total
+ * number of codes.
+ * @param raw - the raw codes, right aligned.
+ * @param packed - the output, AD7293_PACKED_SIZE(num_codes) bytes.
+ * @param num_codes - the number of codes.
+ */
+void ad7293_frame_pack(const uint16_t *raw, uint8_t *packed,
+		       unsigned int num_codes)
+{
+	unsigned int i;
+
+	for (i = 0; i + 1 < num_codes; i += 2) {
+		packed[0] = raw[i] >> 4;
+		packed[1] = ((raw[i] & 0xf) << 4) | ((raw[i + 1] >> 8) & 0xf);
+		packed[2] = raw[i + 1];
+		packed += 3;
+	}
+
+	if (i < num_codes) {
+		packed[0] = raw[i] >> 4;
+		packed[1] = (raw[i] & 0xf) << 4;
+	}
+}
+
+/**
+ * @brief Unpack codes packed by ad7293_frame_pack().
+ * @param packed - the packed codes, AD7293_PACKED_SIZE(num_codes) bytes.
+ * @param raw - the raw codes, right aligned.
+ * @param num_codes - the number of codes.
+ */
+void ad7293_frame_unpack(const uint8_t *packed, uint16_t *raw,
+			 unsigned int num_codes)
+{
+	unsigned int i;
+
+	for (i = 0; i + 1 < num_codes; i += 2) {
+		raw[i] = (packed[0] << 4) | (packed[1] >> 4);
+		raw[i + 1] = ((packed[1] & 0xf) << 8) | packed[2];
+		packed += 3;
+	}
+
+	if (i < num_codes)
+		raw[i] = (packed[0] << 4) | (packed[1] >> 4);
+}
+
+/**
+ * @brief Get the offset register of a channel.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param reg - the register address.
+ * @return Returns 0 in case of success or -EINVAL for an invalid channel.
+ */
+static int ad7293_offset_reg(enum ad7293_ch_type type, unsigned int ch,
+			     unsigned int *reg)
+{
+	const struct ad7293_ch_desc *desc = ad7293_ch_desc(type, ch);
+
+	if (!desc)
+		return -EINVAL;
+
+	*reg = ad7293_ch_offset(desc);
+
+	return 0;
+}
+
+/**
+ * @brief Get offset value for specific channel and channel type.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param offset - the raw value read.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_get_offset(struct ad7293_dev *dev,  enum ad7293_ch_type type,
+		      unsigned int ch, uint16_t *offset)
+{
+	unsigned int reg;
+	int ret;
+
+	ret = ad7293_offset_reg(type, ch, &reg);
+	if (ret)
+		return ret;
+
+	return ad7293_spi_read(dev, reg, offset);
+}
+
+/**
+ * @brief Set offset value for specific channel and channel type.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param offset - the raw value to be written.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_set_offset(struct ad7293_dev *dev,  enum ad7293_ch_type type,
+		      unsigned int ch, uint16_t offset)
+{
+	unsigned int reg;
+	int ret;
+
+	ret = ad7293_offset_reg(type, ch, &reg);
+	if (ret)
+		return ret;
+
+	if (type != AD7293_DAC)
+		return ad7293_spi_write(dev, reg, offset);
+
+	ad7293_lock(dev);
+	ret = __ad7293_dac_write(dev, reg, offset);
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Get a window register of a channel.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param limit - the window register.
+ * @param reg - the register address.
+ * @return Returns 0 in case of success or -EINVAL for a channel without
+ *	   window registers.
+ */
+static int ad7293_limit_reg(enum ad7293_ch_type type, unsigned int ch,
+			    enum ad7293_limit limit, unsigned int *reg)
+{
+	const struct ad7293_ch_desc *desc = ad7293_ch_desc(type, ch);
+
+	if (!desc || !ad7293_ch_has_limits(desc) ||
+	    (unsigned int)limit >= AD7293_NUM_LIMITS)
+		return -EINVAL;
+
+	*reg = ad7293_ch_limit(desc, limit);
+
+	return 0;
+}
+
+/**
+ * @brief Get the high or low limit, the hysteresis or the minimum or maximum
+ *	  result recorded for an ADC channel.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param limit - the window register.
+ * @param raw - the value in ADC codes.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_get_limit(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		     unsigned int ch, enum ad7293_limit limit, uint16_t *raw)
+{
+	unsigned int reg;
+	uint16_t data;
+	int ret;
+
+	ret = ad7293_limit_reg(type, ch, limit, &reg);
+	if (ret)
+		return ret;
+
+	ret = ad7293_spi_read(dev, reg, &data);
+	if (ret)
+		return ret;
+
+	*raw = no_os_field_get(AD7293_REG_DATA_RAW_MSK, data);
+
+	return 0;
+}
+
+/**
+ * @brief Set a window register of an ADC channel. Writing the minimum or
+ *	  maximum restarts its tracking from the value written.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param limit - the window register.
+ * @param raw - the value in ADC codes.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_set_limit(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		     unsigned int ch, enum ad7293_limit limit, uint16_t raw)
+{
+	unsigned int reg;
+	int ret;
+
+	ret = ad7293_limit_reg(type, ch, limit, &reg);
+	if (ret)
+		return ret;
+
+	if (raw > NO_OS_GENMASK(AD7293_ADC_RESOLUTION - 1, 0))
+		return -EINVAL;
+
+	return ad7293_spi_write(dev, reg,
+				no_os_field_prep(AD7293_REG_DATA_RAW_MSK, raw));
+}
+
+/**
+ * @brief Get the offset code of a DAC output, as in the Linux driver.
+ * @param dev - The device structure.
+ * @param ch - the DAC channel number.
+ * @param code - the offset code read, 0 to AD7293_DAC_OFFSET_MAX.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_get_dac_offset(struct ad7293_dev *dev, unsigned int ch,
+			  uint8_t *code)
+{
+	uint16_t data;
+	int ret;
+
+	ret = ad7293_get_offset(dev, AD7293_DAC, ch, &data);
+	if (ret)
+		return ret;
+
+	*code = no_os_field_get(AD7293_REG_VOUT_OFFSET_MSK, data);
+
+	return 0;
+}
+
+/**
+ * @brief Set the offset code of a DAC output, leaving the other bits of the
+ *	  offset register untouched.
+ * @param dev - The device structure.
+ * @param ch - the DAC channel number.
+ * @param code - the offset code, 0 to AD7293_DAC_OFFSET_MAX.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_set_dac_offset(struct ad7293_dev *dev, unsigned int ch,
+			  uint8_t code)
+{
+	unsigned int reg;
+	uint16_t data;
+	int ret;
+
+	if (code > AD7293_DAC_OFFSET_MAX)
+		return -EINVAL;
+
+	ret = ad7293_offset_reg(AD7293_DAC, ch, &reg);
+	if (ret)
+		return ret;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_read(dev, reg, &data);
+	if (ret)
+		goto unlock;
+
+	data &= ~AD7293_REG_VOUT_OFFSET_MSK;
+	data |= no_os_field_prep(AD7293_REG_VOUT_OFFSET_MSK, code);
+
+	ret = __ad7293_dac_write(dev, reg, data);
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Turn on sensor bandgaps on top of those already running, the device
+ *	  lock being held.
+ * @param dev - The device structure.
+ * @param tsense - the temperature sensor bandgaps needed.
+ * @param isense - the current sensor bandgaps needed.
+ * @param rs - the sense resistor monitor bandgaps needed.
+ * @param settle_us - the time the newly enabled bandgaps need to settle.
+ * @return Returns 0 in case of success or negative error code.
+ */
+static int ad7293_bg_start(struct ad7293_dev *dev, uint16_t tsense,
+			   uint16_t isense, uint16_t rs, uint32_t *settle_us)
+{
+	int ret;
+
+	*settle_us = 0;
+
+	tsense &= ~dev->tsense_bg;
+	isense &= ~dev->isense_bg;
+	rs &= ~dev->rs_bg;
+
+	if (tsense) {
+		ret = __ad7293_spi_write(dev, AD7293_REG_TSENSE_BG_EN,
+					 dev->tsense_bg | tsense);
+		if (ret)
+			return ret;
+
+		dev->tsense_bg |= tsense;
+		*settle_us = AD7293_TSENSE_BG_SETTLE_US;
+	}
+
+	if (isense) {
+		ret = __ad7293_spi_write(dev, AD7293_REG_ISENSE_BG_EN,
+					 dev->isense_bg | isense);
+		if (ret)
+			return ret;
+
+		dev->isense_bg |= isense;
+		*settle_us = no_os_max(*settle_us, AD7293_ISENSE_BG_SETTLE_US);
+	}
+
+	if (rs) {
+		ret = __ad7293_spi_write(dev, AD7293_REG_RSX_MON_BG_EN,
+					 dev->rs_bg | rs);
+		if (ret)
+			return ret;
+
+		dev->rs_bg |= rs;
+		*settle_us = no_os_max(*settle_us, AD7293_RS_BG_SETTLE_US);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Enable sensor bandgaps on top of those already running.
+ *
+ * Only the bandgaps that were off pay their settling time, so repeated reads
+ * of the same sensors do not wait. The device is not locked while waiting.
+ * @param dev - The device structure.
+ * @param tsense - the temperature sensor bandgaps needed.
+ * @param isense - the current sensor bandgaps needed.
+ * @param rs - the sense resistor monitor bandgaps needed.
+ * @return Returns 0 in case of success or negative error code.
+ */
+static int ad7293_bg_enable(struct ad7293_dev *dev, uint16_t tsense,
+			    uint16_t isense, uint16_t rs)
+{
+	uint32_t settle_us;
+	int ret;
+
+	ad7293_lock(dev);
+	ret = ad7293_bg_start(dev, tsense, isense, rs, &settle_us);
+	ad7293_unlock(dev);
+	if (ret)
+		return ret;
+
+	if (settle_us)
+		no_os_udelay(settle_us);
+
+	return 0;
+}
+
+/**
+ * @brief Write a list of registers within a single SPI message.
+ *
+ * Each register keeps its own chip select frame and a page select frame is
+ * only inserted when the page changes, so the list should be grouped by page.
+ * The caller holds the device lock.
+ * @param dev - The device structure.
+ * @param regs - The register addresses.
+ * @param vals - The values to write.
+ * @param num - The number of registers.
+ * @return Returns 0 in case of success or negative error code otherwise.
+ */
+static int ad7293_spi_write_seq(struct ad7293_dev *dev,
+				const unsigned int *regs,
+				const uint16_t *vals, unsigned int num)
+{
+	uint8_t page = dev->page_select, *buf;
+	struct no_os_spi_msg *msgs;
+	unsigned int i, n = 0, len;
+	int ret;
+
+	if (!num)
+		return 0;
+
+	msgs = calloc(2 * num, sizeof(*msgs));
+	if (!msgs)
+		return -ENOMEM;
+
+	buf = calloc(2 * num, AD7293_BUFF_SIZE_BYTES);
+	if (!buf) {
+		free(msgs);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num; i++) {
+		msgs[n].tx_buff = &buf[AD7293_BUFF_SIZE_BYTES * n];
+
+		len = ad7293_frame_page(msgs[n].tx_buff, page, regs[i]);
+		if (len) {
+			page = ad7293_reg_page(regs[i]);
+
+			msgs[n].bytes_number = len;
+			msgs[n].cs_change = 1;
+			n++;
+
+			msgs[n].tx_buff = &buf[AD7293_BUFF_SIZE_BYTES * n];
+		}
+
+		msgs[n].bytes_number = ad7293_frame_write(msgs[n].tx_buff,
+							  regs[i], vals[i]);
+		msgs[n].cs_change = 1;
+		n++;
+	}
+
+	ret = no_os_spi_transfer(dev->spi_desc, msgs, n);
+	dev->page_select = ret ? AD7293_PAGE_INVALID : page;
+
+	free(buf);
+	free(msgs);
+
+	return ret;
+}
+
+/**
+ * @brief Return the offset register stored at an index of struct ad7293_calib.
+ * @param i - the index in ad7293_calib.offset.
+ * @return The register address.
+ */
+static unsigned int ad7293_calib_reg(unsigned int i)
+{
+	if (i < 4)
+		return AD7293_REG_VIN0_OFFSET + i;
+	if (i < 7)
+		return AD7293_REG_TSENSE_INT_OFFSET + i - 4;
+	if (i < 11)
+		return AD7293_REG_ISENSE0_OFFSET + i - 7;
+	if (i < 19)
+		return AD7293_REG_UNI_VOUT0_OFFSET + i - 11;
+	if (i < 27)
+		return AD7293_REG_AVDD_OFFSET + i - 19;
+
+	return AD7293_REG_RS0_MON_OFFSET + i - 27;
+}
+
+/**
+ * @brief Return the result or offset register of a VINx or ISENSE channel.
+ * @param j - the channel, VINx first and then ISENSE.
+ * @param offset - true for the offset register, false for the result.
+ * @return The register address.
+ */
+static unsigned int ad7293_calib_ch_reg(unsigned int j, bool offset)
+{
+	/* VINx and then ISENSE also lead the shared channel table */
+	const struct ad7293_ch_desc *desc = &ad7293_ch_descs[AD7293_CH_VIN0 + j];
+
+	if (offset)
+		return ad7293_ch_offset(desc);
+
+	return ad7293_ch_result(desc);
+}
+
+/**
+ * @brief Convert the sequenced channels in bursts and accumulate their codes.
+ *
+ * All 2^AD7293_CALIB_AVG_LOG2 bursts go out in one SPI message, each being a
+ * conversion command followed by the readback of every result.
+ * @param dev - The device structure.
+ * @param vin_mask - the VINx inputs programmed in the sequencer.
+ * @param isense_mask - the ISENSE inputs programmed in the sequencer.
+ * @param sum - the accumulated codes, VINx first and then ISENSE.
+ * @return Returns 0 in case of success or negative error code.
+ */
+static int ad7293_calib_measure(struct ad7293_dev *dev, uint8_t vin_mask,
+				uint8_t isense_mask, uint32_t *sum)
+{
+	unsigned int num_ch = no_os_hweight32(vin_mask) +
+			      no_os_hweight32(isense_mask);
+	unsigned int num = NO_OS_BIT(AD7293_CALIB_AVG_LOG2) * (num_ch + 1);
+	uint32_t latency_us = ad7293_conv_latency_us(dev, num_ch, vin_mask);
+	uint16_t mask = vin_mask | (isense_mask << AD7293_NUM_VINX);
+	struct no_os_spi_msg *msgs;
+	unsigned int i, j, n = 0;
+	uint8_t *buf, *res;
+	int ret;
+
+	/* Conversion command and results share the same page */
+	ret = ad7293_page_select(dev, AD7293_REG_CONV_CMD);
+	if (ret)
+		return ret;
+
+	msgs = calloc(num, sizeof(*msgs));
+	if (!msgs)
+		return -ENOMEM;
+
+	buf = calloc(num, AD7293_BUFF_SIZE_BYTES);
+	if (!buf) {
+		free(msgs);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < NO_OS_BIT(AD7293_CALIB_AVG_LOG2); i++) {
+		msgs[n].tx_buff = &buf[AD7293_BUFF_SIZE_BYTES * n];
+		msgs[n].bytes_number = ad7293_frame_write(msgs[n].tx_buff,
+							  AD7293_REG_CONV_CMD,
+							  AD7293_CONV_CMD_VAL);
+		msgs[n].cs_change = 1;
+		msgs[n].cs_change_delay = latency_us;
+		n++;
+
+		for (j = 0; j < AD7293_NUM_VINX + AD7293_NUM_ISENSE; j++) {
+			if (!(mask & NO_OS_BIT(j)))
+				continue;
+
+			msgs[n].tx_buff = &buf[AD7293_BUFF_SIZE_BYTES * n];
+			msgs[n].rx_buff = msgs[n].tx_buff;
+			msgs[n].bytes_number =
+				ad7293_frame_read(msgs[n].tx_buff,
+						  ad7293_calib_ch_reg(j, false));
+			msgs[n].cs_change = 1;
+			n++;
+		}
+	}
+
+	ret = no_os_spi_transfer(dev->spi_desc, msgs, n);
+	if (ret) {
+		dev->page_select = AD7293_PAGE_INVALID;
+		goto free_buf;
+	}
+
+	for (i = 0, n = 0; i < NO_OS_BIT(AD7293_CALIB_AVG_LOG2); i++) {
+		/* Skip the conversion command */
+		n++;
+
+		for (j = 0; j < AD7293_NUM_VINX + AD7293_NUM_ISENSE; j++) {
+			if (!(mask & NO_OS_BIT(j)))
+				continue;
+
+			res = &buf[AD7293_BUFF_SIZE_BYTES * n + 1];
+			sum[j] += no_os_field_get(AD7293_REG_DATA_RAW_MSK,
+						  no_os_get_unaligned_be16(res));
+			n++;
+		}
+	}
+
+free_buf:
+	free(buf);
+	free(msgs);
+
+	return ret;
+}
+
+/**
+ * @brief Null the offsets of VINx and ISENSE channels held at zero input.
+ *
+ * The offsets of the selected channels are cleared, the channels are
+ * converted together in a few sequenced bursts and the corrections are
+ * written back in one SPI message. Other channels keep their offset.
+ * @param dev - The device structure.
+ * @param vin_mask - the VINx inputs to calibrate.
+ * @param isense_mask - the ISENSE inputs to calibrate.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_calibrate(struct ad7293_dev *dev, uint8_t vin_mask,
+		     uint8_t isense_mask)
+{
+	unsigned int regs[AD7293_NUM_VINX + AD7293_NUM_ISENSE + 2];
+	uint16_t vals[AD7293_NUM_VINX + AD7293_NUM_ISENSE + 2] = {0};
+	uint32_t sum[AD7293_NUM_VINX + AD7293_NUM_ISENSE] = {0};
+	uint16_t mask = vin_mask | (isense_mask << AD7293_NUM_VINX);
+	unsigned int j, n = 0;
+	int32_t code, zero;
+	int ret;
+
+	if ((!vin_mask && !isense_mask) ||
+	    vin_mask & ~NO_OS_GENMASK(AD7293_NUM_VINX - 1, 0) ||
+	    isense_mask & ~NO_OS_GENMASK(AD7293_NUM_ISENSE - 1, 0))
+		return -EINVAL;
+
+	regs[n] = AD7293_REG_VINX_SEQ;
+	vals[n++] = vin_mask;
+	regs[n] = AD7293_REG_ISENSEX_TSENSEX_SEQ;
+	vals[n++] = isense_mask << 8;
+
+	for (j = 0; j < AD7293_NUM_VINX + AD7293_NUM_ISENSE; j++)
+		if (mask & NO_OS_BIT(j))
+			regs[n++] = ad7293_calib_ch_reg(j, true);
+
+	/* Settle the bandgaps before the device is held for the whole run */
+	ret = ad7293_bg_enable(dev, 0, isense_mask, 0);
+	if (ret)
+		return ret;
+
+	ad7293_lock(dev);
+
+	/* A non-blocking conversion owns the sequencer until it completes */
+	if (dev->conv.state != AD7293_CONV_IDLE) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	ret = ad7293_spi_write_seq(dev, regs, vals, n);
+	if (ret)
+		goto unlock;
+
+	ret = ad7293_calib_measure(dev, vin_mask, isense_mask, sum);
+	if (ret)
+		goto unlock;
+
+	/* Only the offset registers are written back */
+	n = 0;
+	for (j = 0; j < AD7293_NUM_VINX + AD7293_NUM_ISENSE; j++) {
+		if (!(mask & NO_OS_BIT(j)))
+			continue;
+
+		code = (sum[j] + (NO_OS_BIT(AD7293_CALIB_AVG_LOG2) >> 1)) >>
+		       AD7293_CALIB_AVG_LOG2;
+		/* Differential VINx inputs are coded in offset binary */
+		zero = (j < AD7293_NUM_VINX && (dev->vin_diff & NO_OS_BIT(j))) ?
+		       NO_OS_BIT(AD7293_ADC_RESOLUTION - 1) : 0;
+
+		/* The offset registers hold a two's complement correction */
+		regs[n] = ad7293_calib_ch_reg(j, true);
+		vals[n++] = (uint8_t)no_os_clamp(zero - code, INT8_MIN, INT8_MAX);
+	}
+
+	ret = ad7293_spi_write_seq(dev, regs, vals, n);
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Check whether a register is a DAC offset register, where only the
+ * offset field may be set.
+ * @param reg - the register.
+ * @return true for the UNI_VOUTx and BI_VOUTx offset registers.
+ */
+static bool ad7293_is_dac_offset(unsigned int reg)
+{
+	return reg >= AD7293_REG_UNI_VOUT0_OFFSET &&
+	       reg <= AD7293_REG_BI_VOUT3_OFFSET;
+}
+
+/**
+ * @brief Read the offset calibration coefficients.
+ * @param dev - The device structure.
+ * @param calib - the coefficients read.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_calib_get(struct ad7293_dev *dev, struct ad7293_calib *calib)
+{
+	unsigned int i;
+	uint16_t val;
+	int ret;
+
+	calib->version = AD7293_CALIB_VERSION;
+
+	for (i = 0; i < AD7293_NUM_OFFSET_REGS; i++) {
+		ret = ad7293_spi_read(dev, ad7293_calib_reg(i), &val);
+		if (ret)
+			return ret;
+
+		if (ad7293_is_dac_offset(ad7293_calib_reg(i)))
+			val &= AD7293_REG_VOUT_OFFSET_MSK;
+
+		calib->offset[i] = val;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the offset calibration coefficients in one SPI message.
+ * @param dev - The device structure.
+ * @param calib - the coefficients, as returned by ad7293_calib_get().
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_calib_set(struct ad7293_dev *dev, const struct ad7293_calib *calib)
+{
+	unsigned int regs[AD7293_NUM_OFFSET_REGS];
+	uint16_t vals[AD7293_NUM_OFFSET_REGS];
+	unsigned int i;
+	int ret;
+
+	if (calib->version != AD7293_CALIB_VERSION)
+		return -EINVAL;
+
+	for (i = 0; i < AD7293_NUM_OFFSET_REGS; i++) {
+		regs[i] = ad7293_calib_reg(i);
+
+		/* Only the offset field of the DAC registers may be set */
+		if (ad7293_is_dac_offset(regs[i]) &&
+		    calib->offset[i] & ~AD7293_REG_VOUT_OFFSET_MSK)
+			return -EINVAL;
+
+		vals[i] = calib->offset[i];
+	}
+
+	ad7293_lock(dev);
+
+	if (!dev->verify_writes) {
+		ret = ad7293_spi_write_seq(dev, regs, vals,
+					   AD7293_NUM_OFFSET_REGS);
+		goto unlock;
+	}
+
+	/* Read back one register at a time, like any other offset update */
+	for (i = 0; i < AD7293_NUM_OFFSET_REGS; i++) {
+		ret = __ad7293_spi_write_verify(dev, regs[i], vals[i]);
+		if (ret)
+			break;
+	}
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Set the delay inserted between two sequenced conversions.
+ * @param dev - The device structure.
+ * @param delay_us - the delay in microseconds, one of 0, 2, 4, ..., 128.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_set_conv_delay(struct ad7293_dev *dev, uint16_t delay_us)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < NO_OS_ARRAY_SIZE(ad7293_conv_delay_table); i++) {
+		if (ad7293_conv_delay_table[i] == delay_us)
+			break;
+	}
+
+	if (i == NO_OS_ARRAY_SIZE(ad7293_conv_delay_table))
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_update_bits(dev, AD7293_REG_CONV_DELAY,
+				       AD7293_REG_CONV_DELAY_MSK,
+				       no_os_field_prep(AD7293_REG_CONV_DELAY_MSK, i));
+	if (!ret)
+		dev->conv_delay = i;
+
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Get the delay inserted between two sequenced conversions.
+ * @param dev - The device structure.
+ * @return The delay in microseconds.
+ */
+uint16_t ad7293_get_conv_delay(struct ad7293_dev *dev)
+{
+	return ad7293_conv_delay_table[dev->conv_delay];
+}
+
+/**
+ * @brief Enable or disable the input filter of a VINx channel.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param enable - true to enable the filter.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_vin_set_filter(struct ad7293_dev *dev, unsigned int ch,
+			  bool enable)
+{
+	int ret;
+
+	if (ch >= AD7293_NUM_VINX)
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_update_bits(dev, AD7293_REG_VINX_FILTER, NO_OS_BIT(ch),
+				       enable ? NO_OS_BIT(ch) : 0);
+	if (!ret)
+		dev->vin_filter = (dev->vin_filter & ~NO_OS_BIT(ch)) |
+				  (enable << ch);
+
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Select differential or single-ended mode for a VINx channel.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param diff - true for differential mode.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_vin_set_diff(struct ad7293_dev *dev, unsigned int ch, bool diff)
+{
+	int ret;
+
+	if (ch >= AD7293_NUM_VINX)
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_update_bits(dev, AD7293_REG_VINX_DIFF_SE, NO_OS_BIT(ch),
+				       diff ? NO_OS_BIT(ch) : 0);
+	if (!ret)
+		dev->vin_diff = (dev->vin_diff & ~NO_OS_BIT(ch)) | (diff << ch);
+
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Set the number of conversions averaged into one VINx or ISENSE result.
+ * @param dev - The device structure.
+ * @param type - The channel type, AD7293_ADC_VINX or AD7293_ADC_ISENSE.
+ * @param ch - the channel number.
+ * @param ratio - the oversampling ratio, a power of two up to 64.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_set_oversampling(struct ad7293_dev *dev, enum ad7293_ch_type type,
+			    unsigned int ch, unsigned int ratio)
+{
+	if (!ratio || ratio > NO_OS_BIT(AD7293_OSR_MAX_LOG2) ||
+	    (ratio & (ratio - 1)))
+		return -EINVAL;
+
+	switch (type) {
+	case AD7293_ADC_VINX:
+		if (ch >= AD7293_NUM_VINX)
+			return -EINVAL;
+
+		dev->vin_osr[ch] = no_os_find_first_set_bit(ratio);
+
+		return 0;
+	case AD7293_ADC_ISENSE:
+		if (ch >= AD7293_NUM_ISENSE)
+			return -EINVAL;
+
+		dev->isense_osr[ch] = no_os_find_first_set_bit(ratio);
+
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/**
+ * @brief Compute the time needed by the sequencer to convert a set of channels.
+ * @param dev - The device structure.
+ * @param num_conv - the number of sequenced conversions.
+ * @param vin_mask - the VINx inputs taking part in the sequence.
+ * @return The conversion latency in microseconds.
+ */
+uint32_t ad7293_conv_latency_us(struct ad7293_dev *dev, unsigned int num_conv,
+				uint16_t vin_mask)
+{
+	uint32_t t_ns;
+
+	t_ns = num_conv * (AD7293_CONV_TIME_NS +
+			   ad7293_conv_delay_table[dev->conv_delay] * 1000);
+	t_ns += no_os_hweight32(vin_mask & dev->vin_filter) *
+		AD7293_FILTER_SETTLE_NS;
+
+	return NO_OS_DIV_ROUND_UP(t_ns, 1000);
+}
+
+/**
+ * @brief Check whether a conversion is in progress.
+ *
+ * The register map documents no conversion status bit, so without the BUSY
+ * input the conversion is taken as done once its computed latency elapsed.
+ * @param dev - The device structure.
+ * @param busy - nonzero while converting.
+ * @return Returns 0 in case of success or negative error code.
+ */
+static int ad7293_conv_busy(struct ad7293_dev *dev, uint8_t *busy)
+{
+	uint8_t level;
+	int ret;
+
+	if (!dev->gpio_busy || !(dev->gpio_func & dev->busy_func)) {
+		*busy = 0;
+		return 0;
+	}
+
+	ret = no_os_gpio_get_value(dev->gpio_busy, &level);
+	if (ret)
+		return ret;
+
+	*busy = !!level == !!(dev->gpio_func_pol & dev->busy_func);
+
+	return 0;
+}
+
+/**
+ * @brief Wait for the end of the conversion started by the last command.
+ *
+ * The BUSY input is sampled when its pin is routed, otherwise the computed
+ * latency is waited out.
+ * @param dev - The device structure.
+ * @param latency_us - the expected conversion latency in microseconds.
+ * @return Returns 0 in case of success or negative error code.
+ */
+static int __ad7293_wait_conversion(struct ad7293_dev *dev,
+				    uint32_t latency_us)
+{
+	uint32_t timeout_us = latency_us + AD7293_CONV_TIMEOUT_US;
+	uint8_t busy;
+	int ret;
+
+	if (!dev->gpio_busy || !(dev->gpio_func & dev->busy_func)) {
+		no_os_udelay(latency_us);
+		return 0;
+	}
+
+	do {
+		ret = ad7293_conv_busy(dev, &busy);
+		if (ret)
+			return ret;
+
+		if (!busy)
+			return 0;
+
+		no_os_udelay(1);
+	} while (--timeout_us);
+
+	return -ETIMEDOUT;
+}
+
+/**
+ * @brief Wait for the end of the conversion started by the last command.
+ * @param dev - The device structure.
+ * @param latency_us - the expected conversion latency in microseconds.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_wait_conversion(struct ad7293_dev *dev, uint32_t latency_us)
+{
+	int ret;
+
+	ad7293_lock(dev);
+	ret = __ad7293_wait_conversion(dev, latency_us);
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Set the DAC output raw value.
+ * @param dev - The device structure.
+ * @param ch - the channel number.
+ * @param raw - the raw value to be written.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_dac_write_raw(struct ad7293_dev *dev, unsigned int ch,
+			 uint16_t raw)
+{
+	const struct ad7293_ch_desc *desc = ad7293_ch_desc(AD7293_DAC, ch);
+	uint16_t dac_en;
+	int ret;
+
+	if (!desc)
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	ret = __ad7293_spi_read(dev, AD7293_REG_DAC_EN, &dac_en);
+	if (ret)
+		goto unlock;
+
+	ret = __ad7293_dac_write(dev, AD7293_REG_DAC_EN, dac_en | NO_OS_BIT(ch));
+	if (ret)
+		goto unlock;
+
+	ret = __ad7293_dac_write(dev, ad7293_ch_result(desc),
+				 no_os_field_prep(AD7293_REG_DATA_RAW_MSK, raw));
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Look up the registers converting an ADC channel.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param conv - filled with the sequencer and result registers and the OSR.
+ * @return Returns 0 in case of success or negative error code.
+ */
+static int ad7293_conv_setup(struct ad7293_dev *dev, enum ad7293_ch_type type,
+			     unsigned int ch, struct ad7293_conv *conv)
+{
+	const struct ad7293_ch_desc *desc = ad7293_ch_desc(type, ch);
+
+	if (!desc || !desc->seq_addr)
+		return -EINVAL;
+
+	conv->seq_reg = ad7293_ch_seq(desc);
+	conv->seq_val = desc->seq_bit;
+	conv->reg_rd = ad7293_ch_result(desc);
+	conv->vin_mask = desc->vin_bit;
+
+	if (type == AD7293_ADC_VINX)
+		conv->osr = dev->vin_osr[ch];
+	else if (type == AD7293_ADC_ISENSE)
+		conv->osr = dev->isense_osr[ch];
+	else
+		conv->osr = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Read raw value for specific channel and channel type.
+ * @param dev - The device structure.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param raw - the raw value read.
+ * @return Returns 0 in case of success or negative error code.
+ */
+int ad7293_ch_read_raw(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		       unsigned int ch, uint16_t *raw)
+{
+	const struct ad7293_ch_desc *desc = ad7293_ch_desc(type, ch);
+	struct ad7293_conv conv;
+	uint16_t data;
+	uint32_t sum = 0;
+	unsigned int i;
+	int ret;
+
+	if (!desc)
+		return -EINVAL;
+
+	if (type == AD7293_DAC) {
+		ret = ad7293_spi_read(dev, ad7293_ch_result(desc), &data);
+		if (ret)
+			return ret;
+
+		*raw = no_os_field_get(AD7293_REG_DATA_RAW_MSK, data);
+
+		return 0;
+	}
+
+	ret = ad7293_conv_setup(dev, type, ch, &conv);
+	if (ret)
+		return ret;
+
+	ret = ad7293_bg_enable(dev, desc->tsense_bg, desc->isense_bg,
+			       desc->rs_bg);
+	if (ret)
+		return ret;
+
+	/* The sequencer must not change until the results are read back */
+	ad7293_lock(dev);
+
+	/* A non-blocking conversion owns the sequencer until it completes */
+	if (dev->conv.state != AD7293_CONV_IDLE) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	ret = __ad7293_spi_write(dev, conv.seq_reg, conv.seq_val);
+	if (ret)
+		goto unlock;
+
+	/* Average 2^osr back to back conversions into one result */
+	for (i = 0; i < NO_OS_BIT(conv.osr); i++) {
+		ret = __ad7293_spi_write(dev, AD7293_REG_CONV_CMD,
+					 AD7293_CONV_CMD_VAL);
+		if (ret)
+			goto unlock;
+
+		ret = __ad7293_wait_conversion(dev,
+					       ad7293_conv_latency_us(dev, 1, conv.vin_mask));
+		if (ret)
+			goto unlock;
+
+		ret = __ad7293_spi_read(dev, conv.reg_rd, &data);
+		if (ret)
+			goto unlock;
+
+		sum += no_os_field_get(AD7293_REG_DATA_RAW_MSK, data);
+	}
+
+	*raw = (sum + (NO_OS_BIT(conv.osr) >> 1)) >> conv.osr;
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Check whether a tick has been reached, the counter wrapping around.
+ * @param now_us - the current tick.
+ * @param deadline_us - the tick waited for.
+ * @return true once now_us is at or past deadline_us.
+ */
+static bool ad7293_tick_reached(uint32_t now_us, uint32_t deadline_us)
+{
+	return (int32_t)(now_us - deadline_us) >= 0;
+}
+
+/**
+ * @brief Issue the next conversion command of a non-blocking conversion.
  * @param dev - The device structure.
- * @param reg - The register address.
- * @return Returns 0 in case of success or negative error code otherwise.
+ * @param now_us - the current tick in microseconds.
+ * @return Returns 0 in case of success or negative error code.
  */
-static int ad7293_page_select(struct ad7293_dev *dev, unsigned int reg)
+static int ad7293_conv_issue(struct ad7293_dev *dev, uint32_t now_us)
 {
+	struct ad7293_conv *conv = &dev->conv;
 	int ret;
-	uint8_t data[2];
 
-	if (dev->page_select != no_os_field_get(AD7293_PAGE_ADDR_MSK, reg)) {
-		data[0] = no_os_field_get(AD7293_REG_ADDR_MSK, AD7293_REG_PAGE_SELECT);
-		data[1] = no_os_field_get(AD7293_PAGE_ADDR_MSK, reg);
+	ret = __ad7293_spi_write(dev, AD7293_REG_CONV_CMD, AD7293_CONV_CMD_VAL);
+	if (ret)
+		return ret;
 
-		ret = no_os_spi_write_and_read(dev->spi_desc, data, 2);
-		if (ret)
-			return ret;
+	if (!conv->count)
+		conv->start_us = now_us;
 
-		dev->page_select = no_os_field_get(AD7293_PAGE_ADDR_MSK, reg);
-	}
+	conv->deadline_us = now_us +
+			    ad7293_conv_latency_us(dev, 1, conv->vin_mask);
+	conv->state = AD7293_CONV_BUSY;
 
 	return 0;
 }
 
 /**
- * @brief Reads data from AD7293 over SPI.
+ * @brief Start converting an ADC channel without waiting for the result.
+ *
+ * The bandgap settling time and the conversions run while the caller goes on
+ * with other work, ad7293_conv_poll() moving the conversion forward. No other
+ * access to the device may be made until the conversion completes or fails.
  * @param dev - The device structure.
- * @param reg - The register address.
- * @param val - Data read from the device.
- * @return Returns 0 in case of success or negative error code otherwise.
+ * @param type - The channel type.
+ * @param ch - the channel number.
+ * @param now_us - the current tick in microseconds.
+ * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_spi_read(struct ad7293_dev *dev, unsigned int reg, uint16_t *val)
+int ad7293_conv_start(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		      unsigned int ch, uint32_t now_us)
 {
-	uint8_t buff[AD7293_BUFF_SIZE_BYTES];
-	unsigned int length;
+	struct ad7293_conv *conv = &dev->conv;
+	const struct ad7293_ch_desc *desc;
+	uint32_t settle_us;
 	int ret;
 
-	length = no_os_field_get(AD7293_TRANSF_LEN_MSK, reg);
+	ad7293_lock(dev);
 
-	ret = ad7293_page_select(dev, reg);
+	if (conv->state != AD7293_CONV_IDLE) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	ret = ad7293_conv_setup(dev, type, ch, conv);
 	if (ret)
-		return ret;
+		goto unlock;
 
-	buff[0] = AD7293_READ | no_os_field_get(AD7293_REG_ADDR_MSK, reg);
-	buff[1] = 0x0;
-	buff[2] = 0x0;
+	desc = ad7293_ch_desc(type, ch);
+	ret = ad7293_bg_start(dev, desc->tsense_bg, desc->isense_bg,
+			      desc->rs_bg, &settle_us);
+	if (ret)
+		goto unlock;
 
-	ret = no_os_spi_write_and_read(dev->spi_desc, buff, length + 1);
+	ret = __ad7293_spi_write(dev, conv->seq_reg, conv->seq_val);
 	if (ret)
-		return ret;
+		goto unlock;
 
-	if (length == 1)
-		*val = buff[1];
-	else
-		*val = no_os_get_unaligned_be16(&buff[1]);
+	conv->count = 0;
+	conv->sum = 0;
 
-	return 0;
+	if (settle_us) {
+		conv->deadline_us = now_us + settle_us;
+		conv->state = AD7293_CONV_SETTLE;
+	} else {
+		ret = ad7293_conv_issue(dev, now_us);
+	}
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
 }
 
 /**
- * @brief Writes data to AD7293 over SPI.
+ * @brief Move a non-blocking conversion forward, the device lock being held.
  * @param dev - The device structure.
- * @param reg - The register address.
- * @param val - Data value to write.
- * @return Returns 0 in case of success or negative error code otherwise.
+ * @param now_us - the current tick in microseconds.
+ * @param raw - the averaged raw value, once complete.
+ * @param timestamp_us - optional, the tick of the first conversion command.
+ * @return Returns 0 once the result is available, -EAGAIN while the
+ *         conversion is in progress or negative error code otherwise.
  */
-int ad7293_spi_write(struct ad7293_dev *dev, unsigned int reg, uint16_t val)
+static int __ad7293_conv_poll(struct ad7293_dev *dev, uint32_t now_us,
+			      uint16_t *raw, uint32_t *timestamp_us)
 {
-	uint8_t buff[AD7293_BUFF_SIZE_BYTES];
-	unsigned int length;
+	struct ad7293_conv *conv = &dev->conv;
+	uint16_t data;
+	uint8_t busy;
 	int ret;
 
-	length = no_os_field_get(AD7293_TRANSF_LEN_MSK, reg);
+	switch (conv->state) {
+	case AD7293_CONV_SETTLE:
+		if (!ad7293_tick_reached(now_us, conv->deadline_us))
+			return -EAGAIN;
 
-	ret = ad7293_page_select(dev, reg);
-	if (ret)
-		return ret;
+		ret = ad7293_conv_issue(dev, now_us);
+		if (ret)
+			goto abort;
 
-	buff[0] = no_os_field_get(AD7293_REG_ADDR_MSK, reg);
+		return -EAGAIN;
+	case AD7293_CONV_BUSY:
+		if (!ad7293_tick_reached(now_us, conv->deadline_us))
+			return -EAGAIN;
 
-	if (length == 1)
-		buff[1] = val;
-	else
-		no_os_put_unaligned_be16(val, &buff[1]);
+		ret = ad7293_conv_busy(dev, &busy);
+		if (ret)
+			goto abort;
+
+		if (busy) {
+			if (ad7293_tick_reached(now_us, conv->deadline_us +
+						AD7293_CONV_TIMEOUT_US)) {
+				ret = -ETIMEDOUT;
+				goto abort;
+			}
+
+			return -EAGAIN;
+		}
+
+		ret = __ad7293_spi_read(dev, conv->reg_rd, &data);
+		if (ret)
+			goto abort;
+
+		conv->sum += no_os_field_get(AD7293_REG_DATA_RAW_MSK, data);
+
+		/* Average 2^osr conversions into one result */
+		if (++conv->count < NO_OS_BIT(conv->osr)) {
+			ret = ad7293_conv_issue(dev, now_us);
+			if (ret)
+				goto abort;
+
+			return -EAGAIN;
+		}
+
+		*raw = (conv->sum + (NO_OS_BIT(conv->osr) >> 1)) >> conv->osr;
+		if (timestamp_us)
+			*timestamp_us = conv->start_us;
+
+		conv->state = AD7293_CONV_IDLE;
+
+		return 0;
+	default:
+		return -EINVAL;
+	}
+
+abort:
+	conv->state = AD7293_CONV_IDLE;
 
-	return no_os_spi_write_and_read(dev->spi_desc, buff, length + 1);
+	return ret;
 }
 
 /**
- * @brief Update AD7293 register.
+ * @brief Move a non-blocking conversion forward.
+ *
+ * Meant to be called from the main loop until it stops returning -EAGAIN.
+ * Each call performs at most one conversion step and never delays.
  * @param dev - The device structure.
- * @param reg - The register address.
- * @param mask - Mask for specific register bits to be updated.
- * @param val - Data written to the device (requires prior bit shifting).
- * @return Returns 0 in case of success or negative error code otherwise.
+ * @param now_us - the current tick in microseconds.
+ * @param raw - the averaged raw value, once complete.
+ * @param timestamp_us - optional, the tick of the first conversion command.
+ * @return Returns 0 once the result is available, -EAGAIN while the
+ *         conversion is in progress or negative error code otherwise.
  */
-int ad7293_spi_update_bits(struct ad7293_dev *dev, unsigned int reg,
-			   uint16_t mask, uint16_t val)
+int ad7293_conv_poll(struct ad7293_dev *dev, uint32_t now_us, uint16_t *raw,
+		     uint32_t *timestamp_us)
 {
 	int ret;
-	uint16_t data, temp;
-
-	ret = ad7293_spi_read(dev, reg, &data);
-	if (ret)
-		return ret;
 
-	temp = (data & ~mask) | (val & mask);
+	ad7293_lock(dev);
+	ret = __ad7293_conv_poll(dev, now_us, raw, timestamp_us);
+	ad7293_unlock(dev);
 
-	return ad7293_spi_write(dev, reg, temp);
+	return ret;
 }
 
 /**
- * @brief Get the range value for ADC channels.
+ * @brief Route the alert and busy functions to the digital pins.
  * @param dev - The device structure.
- * @param ch - the channel number.
- * @param range - the range value.
+ * @param func - the pins driven by their function rather than used as GPIOs.
+ * @param pol - the function pins asserted high.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_adc_get_range(struct ad7293_dev *dev, unsigned int ch,
-			 uint16_t *range)
+int ad7293_set_digital_func(struct ad7293_dev *dev, uint16_t func,
+			    uint16_t pol)
 {
 	int ret;
-	uint16_t data;
 
-	ret = ad7293_spi_read(dev, AD7293_REG_VINX_RANGE1, &data);
-	if (ret)
-		return ret;
+	if ((func | pol) & ~NO_OS_GENMASK(AD7293_NUM_GPIO - 1, 0))
+		return -EINVAL;
 
-	*range = AD7293_REG_VINX_RANGE_GET_CH_MSK(data, ch);
+	ad7293_lock(dev);
 
-	ret = ad7293_spi_read(dev, AD7293_REG_VINX_RANGE0, &data);
+	/* Polarity first, so the pins never glitch to the wrong level */
+	ret = __ad7293_spi_write(dev, AD7293_REG_DIGITAL_FUNC_POL, pol);
 	if (ret)
-		return ret;
+		goto unlock;
 
-	*range |= AD7293_REG_VINX_RANGE_GET_CH_MSK(data, ch) << 1;
+	dev->gpio_func_pol = pol;
 
-	return 0;
+	ret = __ad7293_spi_write(dev, AD7293_REG_DIGITAL_INOUT_FUNC, func);
+	if (!ret)
+		dev->gpio_func = func;
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
 }
 
 /**
- * @brief Set the range value for ADC channels.
+ * @brief Enable or disable the output driver of a digital pin.
  * @param dev - The device structure.
- * @param ch - the channel number.
- * @param range - the range value.
+ * @param pin - the pin number.
+ * @param output - true to drive the pin.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_adc_set_range(struct ad7293_dev *dev, unsigned int ch,
-			 uint16_t range)
+static int ad7293_gpio_set_dir(struct ad7293_dev *dev, unsigned int pin,
+			       bool output)
 {
+	uint16_t out_en;
 	int ret;
-	unsigned int ch_msk = NO_OS_BIT(ch);
 
-	ret = ad7293_spi_update_bits(dev, AD7293_REG_VINX_RANGE1, ch_msk,
-				     AD7293_REG_VINX_RANGE_SET_CH_MSK(range, ch));
-	if (ret)
-		return ret;
+	if (pin >= AD7293_NUM_GPIO)
+		return -EINVAL;
+
+	ad7293_lock(dev);
+
+	if (dev->gpio_func & NO_OS_BIT(pin)) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	out_en = (dev->gpio_out_en & ~NO_OS_BIT(pin)) | (output << pin);
+
+	ret = __ad7293_spi_write(dev, AD7293_REG_DIGITAL_OUT_EN, out_en);
+	if (!ret)
+		dev->gpio_out_en = out_en;
+unlock:
+	ad7293_unlock(dev);
 
-	return ad7293_spi_update_bits(dev, AD7293_REG_VINX_RANGE0, ch_msk,
-				      AD7293_REG_VINX_RANGE_SET_CH_MSK((range >> 1), ch));
+	return ret;
 }
 
 /**
- * @brief Set the gain value for ISENSE channels.
+ * @brief Configure a digital pin as input.
  * @param dev - The device structure.
- * @param ch - the channel number.
- * @param gain - the range value.
+ * @param pin - the pin number.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_isense_set_gain(struct ad7293_dev *dev, unsigned int ch,
-			   uint16_t gain)
+int ad7293_gpio_direction_input(struct ad7293_dev *dev, unsigned int pin)
 {
-	unsigned int ch_msk = (0xf << (4 * ch));
-
-	return ad7293_spi_update_bits(dev, AD7293_REG_ISENSE_GAIN, ch_msk,
-				      gain << (4 * ch));
+	return ad7293_gpio_set_dir(dev, pin, false);
 }
 
 /**
- * @brief Get the gain value for ISENSE channels.
+ * @brief Configure a digital pin as output, its level being set first.
  * @param dev - The device structure.
- * @param ch - the channel number.
- * @param gain - the gain read.
+ * @param pin - the pin number.
+ * @param value - the output level.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_isense_get_gain(struct ad7293_dev *dev, unsigned int ch,
-			   uint16_t *gain)
+int ad7293_gpio_direction_output(struct ad7293_dev *dev, unsigned int pin,
+				 uint8_t value)
 {
 	int ret;
 
-	ret = ad7293_spi_read(dev, AD7293_REG_ISENSE_GAIN, gain);
+	if (pin >= AD7293_NUM_GPIO)
+		return -EINVAL;
+
+	ret = ad7293_gpio_set_multiple(dev, NO_OS_BIT(pin),
+				       value ? NO_OS_BIT(pin) : 0);
 	if (ret)
 		return ret;
 
-	*gain = (*gain >> (4 * ch)) & 0xf;
-
-	return 0;
+	return ad7293_gpio_set_dir(dev, pin, true);
 }
 
 /**
- * @brief Set offset value for specific channel and channel type.
+ * @brief Read the level of several digital pins with a single access.
  * @param dev - The device structure.
- * @param type - The channel type.
- * @param ch - the channel number.
- * @param offset - the raw value to be written.
+ * @param mask - the pins to read.
+ * @param bits - the levels read, bits outside mask are left untouched.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_get_offset(struct ad7293_dev *dev,  enum ad7293_ch_type type,
-		      unsigned int ch, uint16_t *offset)
+int ad7293_gpio_get_multiple(struct ad7293_dev *dev, uint16_t mask,
+			     uint16_t *bits)
 {
-	unsigned int reg_rd;
-
-	switch (type) {
-	case AD7293_ADC_VINX:
-		reg_rd = AD7293_REG_VIN0_OFFSET;
-
-		break;
-	case AD7293_ADC_TSENSE:
-		reg_rd = AD7293_REG_TSENSE_INT_OFFSET;
-
-		break;
-	case AD7293_ADC_ISENSE:
-		reg_rd = AD7293_REG_ISENSE0_OFFSET;
+	uint16_t val;
+	int ret;
 
-		break;
-	case AD7293_DAC:
-		reg_rd = AD7293_REG_UNI_VOUT0_OFFSET;
+	ret = ad7293_spi_read(dev, AD7293_REG_DIGITAL_INOUT, &val);
+	if (ret)
+		return ret;
 
-		break;
-	default:
-		return -EINVAL;
-	}
+	*bits = (*bits & ~mask) | (val & mask);
 
-	return ad7293_spi_read(dev, reg_rd + ch, offset);
+	return 0;
 }
 
 /**
- * @brief Set offset value for specific channel and channel type.
+ * @brief Set the level of several digital pins with a single write.
+ *
+ * The levels are cached, so the write is skipped when none of them changes.
  * @param dev - The device structure.
- * @param type - The channel type.
- * @param ch - the channel number.
- * @param offset - the raw value read.
+ * @param mask - the pins to update.
+ * @param bits - the new levels.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_set_offset(struct ad7293_dev *dev,  enum ad7293_ch_type type,
-		      unsigned int ch, uint16_t offset)
+int ad7293_gpio_set_multiple(struct ad7293_dev *dev, uint16_t mask,
+			     uint16_t bits)
 {
-	unsigned int reg_wr;
-
-	switch (type) {
-	case AD7293_ADC_VINX:
-		reg_wr = AD7293_REG_VIN0_OFFSET;
-
-		break;
-	case AD7293_ADC_TSENSE:
-		reg_wr = AD7293_REG_TSENSE_INT_OFFSET;
+	uint16_t out;
+	int ret;
 
-		break;
-	case AD7293_ADC_ISENSE:
-		reg_wr = AD7293_REG_ISENSE0_OFFSET;
+	if (mask & ~NO_OS_GENMASK(AD7293_NUM_GPIO - 1, 0))
+		return -EINVAL;
 
-		break;
-	case AD7293_DAC:
-		reg_wr = AD7293_REG_UNI_VOUT0_OFFSET;
+	ad7293_lock(dev);
 
-		break;
-	default:
-		return -EINVAL;
+	out = (dev->gpio_out & ~mask) | (bits & mask);
+	if (out == dev->gpio_out) {
+		ret = 0;
+		goto unlock;
 	}
 
-	return ad7293_spi_write(dev, reg_wr + ch, offset);
+	ret = __ad7293_spi_write(dev, AD7293_REG_DIGITAL_INOUT, out);
+	if (!ret)
+		dev->gpio_out = out;
+unlock:
+	ad7293_unlock(dev);
+
+	return ret;
 }
 
 /**
- * @brief Set the DAC output raw value.
+ * @brief Return the cached device state to its power-on value after a reset.
  * @param dev - The device structure.
- * @param ch - the channel number.
- * @param raw - the raw value to be written.
- * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_dac_write_raw(struct ad7293_dev *dev, unsigned int ch,
-			 uint16_t raw)
+static void ad7293_cache_reset(struct ad7293_dev *dev)
 {
-	int ret;
-
-	ret = ad7293_spi_update_bits(dev, AD7293_REG_DAC_EN, NO_OS_BIT(ch),
-				     NO_OS_BIT(ch));
-	if (ret)
-		return ret;
-
-	return ad7293_spi_write(dev, AD7293_REG_UNI_VOUT0 + ch,
-				no_os_field_prep(AD7293_REG_DATA_RAW_MSK, raw));
+	unsigned int i;
+
+	dev->page_select = AD7293_PAGE_INVALID;
+	dev->conv_delay = 0;
+	dev->vin_filter = 0;
+	dev->vin_diff = 0;
+	for (i = 0; i < AD7293_NUM_VINX; i++)
+		dev->vin_range[i] = 0;
+	for (i = 0; i < AD7293_NUM_ISENSE; i++)
+		dev->isense_gain[i] = 0;
+	/* The sensor bandgaps turn off and the digital pins return to inputs */
+	dev->tsense_bg = 0;
+	dev->isense_bg = 0;
+	dev->rs_bg = 0;
+	dev->gpio_out = 0;
+	dev->gpio_out_en = 0;
+	dev->gpio_func = 0;
+	dev->gpio_func_pol = 0;
+	/* Any pending non-blocking conversion is abandoned */
+	dev->conv.state = AD7293_CONV_IDLE;
 }
 
 /**
- * @brief Read raw value for specific channel and channel type.
+ * @brief Perform software reset, the device lock being held.
  * @param dev - The device structure.
- * @param type - The channel type.
- * @param ch - the channel number.
- * @param raw - the raw value read.
  * @return Returns 0 in case of success or negative error code.
  */
-int ad7293_ch_read_raw(struct ad7293_dev *dev, enum ad7293_ch_type type,
-		       unsigned int ch, uint16_t *raw)
+static int __ad7293_soft_reset(struct ad7293_dev *dev)
 {
 	int ret;
-	unsigned int reg_wr, reg_rd, data_wr;
-
-	switch (type) {
-	case AD7293_ADC_VINX:
-		reg_wr = AD7293_REG_VINX_SEQ;
-		reg_rd = AD7293_REG_VIN0 + ch;
-		data_wr = NO_OS_BIT(ch);
-
-		break;
-	case AD7293_ADC_TSENSE:
-		reg_wr = AD7293_REG_ISENSEX_TSENSEX_SEQ;
-		reg_rd = AD7293_REG_TSENSE_INT + ch;
-		data_wr = NO_OS_BIT(ch);
-
-		break;
-	case AD7293_ADC_ISENSE:
-		reg_wr = AD7293_REG_ISENSEX_TSENSEX_SEQ;
-		reg_rd = AD7293_REG_ISENSE_0 + ch;
-		data_wr = NO_OS_BIT(ch) << 8;
-
-		break;
-	case AD7293_DAC:
-		reg_rd = AD7293_REG_UNI_VOUT0 + ch;
-
-		break;
-	default:
-		return -EINVAL;
-	}
-
-	if (type != AD7293_DAC) {
-		if (type == AD7293_ADC_TSENSE) {
-			ret = ad7293_spi_write(dev, AD7293_REG_TSENSE_BG_EN,
-					       NO_OS_BIT(ch));
-			if (ret)
-				return ret;
-
-			no_os_mdelay(9);
-		} else if (type == AD7293_ADC_ISENSE) {
-			ret = ad7293_spi_write(dev, AD7293_REG_ISENSE_BG_EN,
-					       NO_OS_BIT(ch));
-			if (ret)
-				return ret;
-
-			no_os_mdelay(9);
-		}
-
-		ret = ad7293_spi_write(dev, reg_wr, data_wr);
-		if (ret)
-			return ret;
-
-		ret = ad7293_spi_write(dev, AD7293_REG_CONV_CMD, AD7293_CONV_CMD_VAL);
-		if (ret)
-			return ret;
-	}
 
-	ret = ad7293_spi_read(dev, reg_rd, raw);
+	ret = __ad7293_spi_write(dev, AD7293_REG_SOFT_RESET, AD7293_SOFT_RESET_VAL);
 	if (ret)
 		return ret;
 
-	*raw = no_os_field_get(AD7293_REG_DATA_RAW_MSK, *raw);
+	ad7293_cache_reset(dev);
 
-	return 0;
+	return __ad7293_spi_write(dev, AD7293_REG_SOFT_RESET,
+				  AD7293_SOFT_RESET_CLR_VAL);
 }
 
 /**
@@ -428,11 +2085,11 @@ int ad7293_soft_reset(struct ad7293_dev *dev)
 {
 	int ret;
 
-	ret = ad7293_spi_write(dev, AD7293_REG_SOFT_RESET, AD7293_SOFT_RESET_VAL);
-	if (ret)
-		return ret;
+	ad7293_lock(dev);
+	ret = __ad7293_soft_reset(dev);
+	ad7293_unlock(dev);
 
-	return ad7293_spi_write(dev, AD7293_REG_SOFT_RESET, AD7293_SOFT_RESET_CLR_VAL);
+	return ret;
 }
 
 /**
@@ -442,6 +2099,10 @@ int ad7293_soft_reset(struct ad7293_dev *dev)
  */
 int ad7293_reset(struct ad7293_dev *dev)
 {
+	int ret = 0;
+
+	ad7293_lock(dev);
+
 	if (dev->gpio_reset) {
 		no_os_gpio_direction_output(dev->gpio_reset, NO_OS_GPIO_LOW);
 		/* Datasheet: Minimum Reset pulse width: 90ns */
@@ -450,11 +2111,15 @@ int ad7293_reset(struct ad7293_dev *dev)
 		/* Datasheet: Minimum Reset pulse width: 90ns */
 		no_os_udelay(1);
 
-		return 0;
+		ad7293_cache_reset(dev);
+	} else {
+		/* Perform a software reset */
+		ret = __ad7293_soft_reset(dev);
 	}
 
-	/* Perform a software reset */
-	return ad7293_soft_reset(dev);
+	ad7293_unlock(dev);
+
+	return ret;
 }
 
 /**
@@ -468,6 +2133,7 @@ int ad7293_init(struct ad7293_dev **device,
 {
 	struct ad7293_dev *dev;
 	uint16_t chip_id;
+	unsigned int i;
 	int ret;
 
 	dev = (struct ad7293_dev *)calloc(1, sizeof(*dev));
@@ -483,26 +2149,61 @@ int ad7293_init(struct ad7293_dev **device,
 	if (ret)
 		goto error_spi;
 
-	dev->page_select = 0;
+	ret = no_os_gpio_get_optional(&dev->gpio_busy, init_param->gpio_busy);
+	if (ret)
+		goto error_gpio;
+
+	if (dev->gpio_busy) {
+		ret = no_os_gpio_direction_input(dev->gpio_busy);
+		if (ret)
+			goto error_gpio_busy;
+	}
+
+	/* BUSY must come from a single function pin */
+	if (no_os_hweight32(init_param->busy_func) > 1 ||
+	    init_param->busy_func & ~init_param->digital_func) {
+		ret = -EINVAL;
+		goto error_gpio_busy;
+	}
+
+	dev->busy_func = init_param->busy_func;
+	dev->page_select = AD7293_PAGE_INVALID;
+	dev->verify_writes = init_param->verify_writes;
+	dev->lock = init_param->lock;
+	dev->unlock = init_param->unlock;
+	dev->lock_ctx = init_param->lock_ctx;
+
+	for (i = 0; i < AD7293_NUM_ISENSE; i++)
+		dev->isense_shunt_uohm[i] = init_param->isense_shunt_uohm[i] ?
+					    init_param->isense_shunt_uohm[i] : 1000000;
 
 	ret = ad7293_reset(dev);
 	if (ret)
-		goto error_gpio;
+		goto error_gpio_busy;
 
 	/* Check Chip ID */
 	ret = ad7293_spi_read(dev, AD7293_REG_DEVICE_ID, &chip_id);
 	if (ret)
-		goto error_gpio;
+		goto error_gpio_busy;
 
 	if (chip_id != AD7293_CHIP_ID) {
 		ret = -EINVAL;
-		goto error_gpio;
+		goto error_gpio_busy;
+	}
+
+	if (init_param->digital_func) {
+		ret = ad7293_set_digital_func(dev, init_param->digital_func,
+					      init_param->digital_func_pol);
+		if (ret)
+			goto error_gpio_busy;
 	}
 
 	*device = dev;
 
 	return 0;
 
+error_gpio_busy:
+	no_os_gpio_remove(dev->gpio_busy);
 error_gpio:
 	no_os_gpio_remove(dev->gpio_reset);
 error_spi:
@@ -526,6 +2227,9 @@ int ad7293_remove(struct ad7293_dev *dev)
 	if (ret)
 		return ret;
 
+	no_os_gpio_remove(dev->gpio_reset);
+	no_os_gpio_remove(dev->gpio_busy);
+
 	free(dev);
 
 	return 0;
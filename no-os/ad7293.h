@@ -48,16 +48,12 @@
 #include "no_os_spi.h"
 #include "no_os_gpio.h"
 #include "no_os_util.h"
+#include "../common/ad7293_core.h"
 
 /******************************************************************************/
 /********************** Macros and Constants Definitions **********************/
 /******************************************************************************/
 
-#define AD7293_R1B				NO_OS_BIT(16)
-#define AD7293_R2B				NO_OS_BIT(17)
-#define AD7293_PAGE_ADDR_MSK			NO_OS_GENMASK(15, 8)
-#define AD7293_PAGE(x)				no_os_field_prep(AD7293_PAGE_ADDR_MSK, x)
-
 /* AD7293 Register Map Common */
 #define AD7293_REG_NO_OP			(AD7293_R1B | AD7293_PAGE(0x0) | 0x0)
 #define AD7293_REG_PAGE_SELECT			(AD7293_R1B | AD7293_PAGE(0x0) | 0x1)
@@ -103,6 +99,7 @@
 #define AD7293_REG_RS3_MON			(AD7293_R2B | AD7293_PAGE(0x01) | 0x2B)
 
 /* AD7293 Register Map Page 0x2 */
+#define AD7293_REG_DIGITAL_INOUT		(AD7293_R2B | AD7293_PAGE(0x2) | 0x10)
 #define AD7293_REG_DIGITAL_OUT_EN		(AD7293_R2B | AD7293_PAGE(0x2) | 0x11)
 #define AD7293_REG_DIGITAL_INOUT_FUNC		(AD7293_R2B | AD7293_PAGE(0x2) | 0x12)
 #define AD7293_REG_DIGITAL_FUNC_POL		(AD7293_R2B | AD7293_PAGE(0x2) | 0x13)
@@ -133,6 +130,19 @@
 #define AD7293_REG_ISENSEX_TSENSEX_SEQ		(AD7293_R2B | AD7293_PAGE(0x3) | 0x11)
 #define AD7293_REG_RSX_MON_BI_VOUTX_SEQ		(AD7293_R2B | AD7293_PAGE(0x3) | 0x12)
 
+/* AD7293 Register Map Page 0x04 */
+#define AD7293_REG_VIN0_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x10)
+#define AD7293_REG_VIN1_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x11)
+#define AD7293_REG_VIN2_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x12)
+#define AD7293_REG_VIN3_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x13)
+#define AD7293_REG_TSENSE_INT_HL		(AD7293_R2B | AD7293_PAGE(0x04) | 0x20)
+#define AD7293_REG_TSENSE_D0_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x21)
+#define AD7293_REG_TSENSE_D1_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x22)
+#define AD7293_REG_ISENSE0_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x28)
+#define AD7293_REG_ISENSE1_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x29)
+#define AD7293_REG_ISENSE2_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x2A)
+#define AD7293_REG_ISENSE3_HL			(AD7293_R2B | AD7293_PAGE(0x04) | 0x2B)
+
 /* AD7293 Register Map Page 0x05 */
 #define AD7293_REG_AVDD_HL			(AD7293_R2B | AD7293_PAGE(0x05) | 0x10)
 #define AD7293_REG_DACVDD_UNI_HL		(AD7293_R2B | AD7293_PAGE(0x05) | 0x11)
@@ -316,11 +326,9 @@
 #define AD7293_REG_INT_LIMIT_AVSS_ALERT1	(AD7293_R2B | AD7293_PAGE(0x12) | 0x1A)
 
 /* AD7293 Miscellaneous Definitions */
-#define AD7293_READ				NO_OS_BIT(7)
-#define AD7293_TRANSF_LEN_MSK			NO_OS_GENMASK(17, 16)
-#define AD7293_BUFF_SIZE_BYTES			3
-#define AD7293_REG_ADDR_MSK			NO_OS_GENMASK(7, 0)
+#define AD7293_BUFF_SIZE_BYTES			AD7293_FRAME_MAX_BYTES
 #define AD7293_REG_VOUT_OFFSET_MSK		NO_OS_GENMASK(5, 4)
+#define AD7293_DAC_OFFSET_MAX			2
 #define AD7293_REG_DATA_RAW_MSK			NO_OS_GENMASK(15, 4)
 #define AD7293_REG_VINX_RANGE_GET_CH_MSK(x, ch)	(((x) >> (ch)) & 0x1)
 #define AD7293_REG_VINX_RANGE_SET_CH_MSK(x, ch)	(((x) & 0x1) << (ch))
@@ -328,16 +336,74 @@
 #define AD7293_SOFT_RESET_VAL			0x7293
 #define AD7293_SOFT_RESET_CLR_VAL		0x0000
 #define AD7293_CONV_CMD_VAL			0x82
+#define AD7293_REG_CONV_DELAY_MSK		NO_OS_GENMASK(2, 0)
+#define AD7293_NUM_GPIO				8
+#define AD7293_ADC_RESOLUTION			12
+/*
+ * Bytes taken by n raw codes packed by ad7293_frame_pack(): two codes in
+ * three bytes, most significant bits first, an odd last code in two bytes.
+ */
+#define AD7293_PACKED_SIZE(n)			(((n) * 3 + 1) / 2)
+#define AD7293_REFADC_MV			1250
+#define AD7293_TSENSE_SCALE_MILLI_C		125
+/* log2 of the largest number of conversions averaged into one result */
+#define AD7293_OSR_MAX_LOG2			6
+
+/* Conversions averaged per channel by ad7293_calibrate() */
+#define AD7293_CALIB_AVG_LOG2			4
+/* Layout version of struct ad7293_calib */
+#define AD7293_CALIB_VERSION			1
+/* Offset registers on pages 0xE and 0xF */
+#define AD7293_NUM_OFFSET_REGS			31
+
+/* Conversion time of a single sequenced channel */
+#define AD7293_CONV_TIME_NS			2000
+/* Additional settling time of a VINx input with its filter enabled */
+#define AD7293_FILTER_SETTLE_NS			4000
+/* Margin added on top of the expected latency before giving up */
+#define AD7293_CONV_TIMEOUT_US			1000
+
+/* Settling time of the sensor bandgaps once enabled */
+#define AD7293_TSENSE_BG_SETTLE_US		9000
+#define AD7293_ISENSE_BG_SETTLE_US		2000
+/* Taken as long as for the ISENSE bandgaps, which serve the same purpose */
+#define AD7293_RS_BG_SETTLE_US			2000
 
 /**
- * @enum ad7293_ch_type
- * @brief AD7293 Channel Type
+ * @enum ad7293_conv_state
+ * @brief AD7293 non-blocking conversion state
  */
-enum ad7293_ch_type {
-	AD7293_ADC_VINX,
-	AD7293_ADC_TSENSE,
-	AD7293_ADC_ISENSE,
-	AD7293_DAC,
+enum ad7293_conv_state {
+	/** No conversion pending */
+	AD7293_CONV_IDLE,
+	/** Waiting for the sensor bandgaps to settle */
+	AD7293_CONV_SETTLE,
+	/** Conversion command issued, waiting for its result */
+	AD7293_CONV_BUSY,
+};
+
+/**
+ * @struct ad7293_conv
+ * @brief AD7293 conversion in progress, driven by ad7293_conv_poll().
+ */
+struct ad7293_conv {
+	enum ad7293_conv_state		state;
+	/** Sequencer register and the channel bit to program */
+	unsigned int			seq_reg;
+	uint16_t			seq_val;
+	/** Result register */
+	unsigned int			reg_rd;
+	/** VINx inputs taking part in the conversion */
+	uint16_t			vin_mask;
+	/** log2 of the number of conversions to average */
+	uint8_t				osr;
+	/** Conversions accumulated so far */
+	unsigned int			count;
+	uint32_t			sum;
+	/** Tick at which the current step is expected to be over */
+	uint32_t			deadline_us;
+	/** Tick at which the first conversion command was issued */
+	uint32_t			start_us;
 };
 
 /**
@@ -348,7 +414,58 @@ struct ad7293_dev {
 	/** SPI Descriptor */
 	struct no_os_spi_desc		*spi_desc;
 	struct no_os_gpio_desc		*gpio_reset;
+	/**
+	 * Optional BUSY input, asserted while a conversion is in progress.
+	 * Only sampled while the busy_func pin is routed to its function, with
+	 * the polarity programmed for that pin.
+	 */
+	struct no_os_gpio_desc		*gpio_busy;
+	/** Function pin carrying BUSY, 0 if none */
+	uint16_t			busy_func;
+	/** Selected page, AD7293_PAGE_INVALID when unknown */
 	uint8_t				page_select;
+	/** Page mismatches found by ad7293_page_verify() */
+	uint32_t			page_mismatch;
+	/** Read back DAC settings in the same SPI message they are written */
+	bool				verify_writes;
+	/** Verified writes that did not read back the written value */
+	uint32_t			verify_fail;
+	/** Conversion delay code */
+	uint8_t				conv_delay;
+	/** VINx inputs with the filter enabled */
+	uint8_t				vin_filter;
+	/** VINx inputs in differential mode */
+	uint8_t				vin_diff;
+	/** VINx range codes */
+	uint8_t				vin_range[AD7293_NUM_VINX];
+	/** ISENSE gain codes */
+	uint8_t				isense_gain[AD7293_NUM_ISENSE];
+	/** log2 of the VINx oversampling ratios */
+	uint8_t				vin_osr[AD7293_NUM_VINX];
+	/** log2 of the ISENSE oversampling ratios */
+	uint8_t				isense_osr[AD7293_NUM_ISENSE];
+	/** ISENSE shunt resistors in micro-ohms */
+	uint32_t			isense_shunt_uohm[AD7293_NUM_ISENSE];
+	/** Temperature sensor bandgaps enabled and settled */
+	uint16_t			tsense_bg;
+	/** Current sensor bandgaps enabled and settled */
+	uint16_t			isense_bg;
+	/** Sense resistor monitor bandgaps enabled and settled */
+	uint16_t			rs_bg;
+	/** Digital pin output levels */
+	uint16_t			gpio_out;
+	/** Digital pins configured as outputs */
+	uint16_t			gpio_out_en;
+	/** Digital pins driven by their alert or busy function */
+	uint16_t			gpio_func;
+	/** Function pins asserted high */
+	uint16_t			gpio_func_pol;
+	/** Non-blocking conversion state */
+	struct ad7293_conv		conv;
+	/** Optional lock callbacks, see struct ad7293_init_param */
+	void				(*lock)(void *lock_ctx);
+	void				(*unlock)(void *lock_ctx);
+	void				*lock_ctx;
 };
 
 /**
@@ -359,6 +476,49 @@ struct ad7293_init_param {
 	/** SPI Initialization parameters */
 	struct no_os_spi_init_param	*spi_init;
 	struct no_os_gpio_init_param	*gpio_reset;
+	struct no_os_gpio_init_param	*gpio_busy;
+	/** ISENSE shunt resistors in micro-ohms, 0 selects 1 ohm */
+	uint32_t			isense_shunt_uohm[AD7293_NUM_ISENSE];
+	/** Read back DAC codes, offsets and enables when writing them */
+	bool				verify_writes;
+	/** Digital pins driven by their alert or busy function */
+	uint16_t			digital_func;
+	/** Function pins asserted high, the others being asserted low */
+	uint16_t			digital_func_pol;
+	/**
+	 * Function pin carrying BUSY, as a single bit of digital_func, and
+	 * wired to gpio_busy. 0 if no pin carries it.
+	 */
+	uint16_t			busy_func;
+	/**
+	 * Optional callbacks serializing the bus transactions of this device,
+	 * e.g. no_os_mutex_lock() and no_os_mutex_unlock() on a mutex passed
+	 * as lock_ctx. Leave NULL when a single task uses the device. They
+	 * are never nested and never held across a bandgap settling delay.
+	 */
+	void				(*lock)(void *lock_ctx);
+	void				(*unlock)(void *lock_ctx);
+	void				*lock_ctx;
+};
+
+/**
+ * @struct ad7293_calib
+ * @brief AD7293 offset calibration coefficients of a board.
+ */
+struct ad7293_calib {
+	/** AD7293_CALIB_VERSION */
+	uint8_t				version;
+	/** Offset registers, page 0xE first and then page 0xF */
+	uint8_t				offset[AD7293_NUM_OFFSET_REGS];
+};
+
+/**
+ * @struct ad7293_chan_id
+ * @brief AD7293 channel taking part in a scan frame.
+ */
+struct ad7293_chan_id {
+	enum ad7293_ch_type		type;
+	unsigned int			ch;
 };
 
 /******************************************************************************/
@@ -371,6 +531,13 @@ int ad7293_spi_read(struct ad7293_dev *dev, unsigned int reg, uint16_t *val);
 /** AD7293 SPI write */
 int ad7293_spi_write(struct ad7293_dev *dev, unsigned int reg, uint16_t val);
 
+/** AD7293 SPI write followed by readback in the same message */
+int ad7293_spi_write_verify(struct ad7293_dev *dev, unsigned int reg,
+			    uint16_t val);
+
+/** AD7293 check the page register against the cached page */
+int ad7293_page_verify(struct ad7293_dev *dev);
+
 /** AD7293 SPI update bits */
 int ad7293_spi_update_bits(struct ad7293_dev *dev, unsigned int reg,
 			   uint16_t mask, uint16_t val);
@@ -399,6 +566,78 @@ int ad7293_get_offset(struct ad7293_dev *dev,  enum ad7293_ch_type type,
 int ad7293_set_offset(struct ad7293_dev *dev,  enum ad7293_ch_type type,
 		      unsigned int ch, uint16_t offset);
 
+/** AD7293 get a limit, the hysteresis or the min/max of an ADC channel */
+int ad7293_get_limit(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		     unsigned int ch, enum ad7293_limit limit, uint16_t *raw);
+
+/** AD7293 set a limit, the hysteresis or the min/max of an ADC channel */
+int ad7293_set_limit(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		     unsigned int ch, enum ad7293_limit limit, uint16_t raw);
+
+/** AD7293 get the offset code of a DAC output */
+int ad7293_get_dac_offset(struct ad7293_dev *dev, unsigned int ch,
+			  uint8_t *code);
+
+/** AD7293 set the offset code of a DAC output */
+int ad7293_set_dac_offset(struct ad7293_dev *dev, unsigned int ch,
+			  uint8_t code);
+
+/** AD7293 null the VINx and ISENSE offsets with zero inputs applied */
+int ad7293_calibrate(struct ad7293_dev *dev, uint8_t vin_mask,
+		     uint8_t isense_mask);
+
+/** AD7293 read the offset calibration coefficients */
+int ad7293_calib_get(struct ad7293_dev *dev, struct ad7293_calib *calib);
+
+/** AD7293 write the offset calibration coefficients */
+int ad7293_calib_set(struct ad7293_dev *dev, const struct ad7293_calib *calib);
+
+/** AD7293 set conversion delay */
+int ad7293_set_conv_delay(struct ad7293_dev *dev, uint16_t delay_us);
+
+/** AD7293 get conversion delay */
+uint16_t ad7293_get_conv_delay(struct ad7293_dev *dev);
+
+/** AD7293 enable or disable the VINx input filter */
+int ad7293_vin_set_filter(struct ad7293_dev *dev, unsigned int ch,
+			  bool enable);
+
+/** AD7293 select differential or single-ended VINx input */
+int ad7293_vin_set_diff(struct ad7293_dev *dev, unsigned int ch, bool diff);
+
+/** AD7293 set the number of conversions averaged into one result */
+int ad7293_set_oversampling(struct ad7293_dev *dev, enum ad7293_ch_type type,
+			    unsigned int ch, unsigned int ratio);
+
+/** AD7293 conversion latency of a sequence */
+uint32_t ad7293_conv_latency_us(struct ad7293_dev *dev, unsigned int num_conv,
+				uint16_t vin_mask);
+
+/** AD7293 wait for the end of a conversion */
+int ad7293_wait_conversion(struct ad7293_dev *dev, uint32_t latency_us);
+
+/** AD7293 get channel scale in engineering units per LSB */
+int ad7293_get_scale(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		     unsigned int ch, float *scale);
+
+/** AD7293 compute the conversion coefficients of a scan frame */
+int ad7293_frame_scale_init(struct ad7293_dev *dev,
+			    const struct ad7293_chan_id *chans,
+			    unsigned int num_chans, float *coeffs);
+
+/** AD7293 convert scan frames to engineering units */
+void ad7293_frame_to_units(const float *coeffs, const uint16_t *raw,
+			   float *out, unsigned int num_chans,
+			   unsigned int num_frames);
+
+/** AD7293 pack raw codes two in three bytes */
+void ad7293_frame_pack(const uint16_t *raw, uint8_t *packed,
+		       unsigned int num_codes);
+
+/** AD7293 unpack codes packed by ad7293_frame_pack() */
+void ad7293_frame_unpack(const uint8_t *packed, uint16_t *raw,
+			 unsigned int num_codes);
+
 /** AD7293 write DAC value */
 int ad7293_dac_write_raw(struct ad7293_dev *dev, unsigned int ch,
 			 uint16_t raw);
@@ -407,6 +646,33 @@ int ad7293_dac_write_raw(struct ad7293_dev *dev, unsigned int ch,
 int ad7293_ch_read_raw(struct ad7293_dev *dev, enum ad7293_ch_type type,
 		       unsigned int ch, uint16_t *raw);
 
+/** AD7293 start a non-blocking conversion */
+int ad7293_conv_start(struct ad7293_dev *dev, enum ad7293_ch_type type,
+		      unsigned int ch, uint32_t now_us);
+
+/** AD7293 advance a non-blocking conversion */
+int ad7293_conv_poll(struct ad7293_dev *dev, uint32_t now_us, uint16_t *raw,
+		     uint32_t *timestamp_us);
+
+/** AD7293 route the alert and busy functions to the digital pins */
+int ad7293_set_digital_func(struct ad7293_dev *dev, uint16_t func,
+			    uint16_t pol);
+
+/** AD7293 configure a digital pin as input */
+int ad7293_gpio_direction_input(struct ad7293_dev *dev, unsigned int pin);
+
+/** AD7293 configure a digital pin as output */
+int ad7293_gpio_direction_output(struct ad7293_dev *dev, unsigned int pin,
+				 uint8_t value);
+
+/** AD7293 read the level of several digital pins */
+int ad7293_gpio_get_multiple(struct ad7293_dev *dev, uint16_t mask,
+			     uint16_t *bits);
+
+/** AD7293 set the level of several digital pins */
+int ad7293_gpio_set_multiple(struct ad7293_dev *dev, uint16_t mask,
+			     uint16_t bits);
+
 /** AD7293 Software Reset */
 int ad7293_soft_reset(struct ad7293_dev *dev);
 